@@ -0,0 +1,135 @@
+// partition_ordering_bench.cpp
+// Compares plane orderings of SpacePartitioner on the contour files in the
+// data directory and on synthetic slice stacks.
+#include "partition.h"
+#include "geometry.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+namespace fs = std::filesystem;
+
+namespace {
+
+// Circular contour of the given radius centred on the plane's origin
+ContourPlane makeCircleContour(const Plane& plane, double radius, int segments,
+                               const std::string& filename) {
+    ContourPlane contour;
+    contour.plane = plane;
+    contour.filename = filename;
+
+    PlaneFrame frame = PlaneFrame::fromPlane(plane);
+    for (int i = 0; i < segments; ++i) {
+        double angle = 2.0 * M_PI * i / segments;
+        contour.vertices.push_back(frame.to3d(Point2(radius * std::cos(angle),
+                                                     radius * std::sin(angle))));
+        contour.edges.emplace_back(i, (i + 1) % segments);
+    }
+    return contour;
+}
+
+// Parallel slices along z
+std::vector<ContourPlane> makeParallelStack(int count) {
+    std::string name = "synthetic_parallel_" + std::to_string(count) + ".contour";
+    std::vector<ContourPlane> planes;
+    for (int i = 0; i < count; ++i) {
+        double z = i - 0.5 * (count - 1);
+        planes.push_back(makeCircleContour(Plane(0, 0, 1, -z), 2.0, 16, name));
+    }
+    return planes;
+}
+
+// Oblique slices tilted progressively around the y axis
+std::vector<ContourPlane> makeObliqueStack(int count) {
+    std::string name = "synthetic_oblique_" + std::to_string(count) + ".contour";
+    std::vector<ContourPlane> planes;
+    for (int i = 0; i < count; ++i) {
+        double angle = M_PI * i / count;
+        double offset = 0.25 * (i - 0.5 * (count - 1));
+        planes.push_back(makeCircleContour(
+            Plane(std::cos(angle), 0.1 * i, std::sin(angle), -offset), 2.0, 16, name));
+    }
+    return planes;
+}
+
+const char* orderingName(SpacePartitioner::PlaneOrdering ordering) {
+    switch (ordering) {
+        case SpacePartitioner::PlaneOrdering::FileOrder: return "file";
+        case SpacePartitioner::PlaneOrdering::MostBalanced: return "balanced";
+        case SpacePartitioner::PlaneOrdering::FewestCrossings: return "crossings";
+    }
+    return "?";
+}
+
+void runOrderings(const std::string& label, const std::vector<ContourPlane>& planes,
+                  bool footprint) {
+    const SpacePartitioner::PlaneOrdering orderings[] = {
+        SpacePartitioner::PlaneOrdering::FileOrder,
+        SpacePartitioner::PlaneOrdering::MostBalanced,
+        SpacePartitioner::PlaneOrdering::FewestCrossings
+    };
+
+    for (auto ordering : orderings) {
+        SpacePartitioner partitioner(planes);
+        partitioner.setCacheEnabled(false);
+        partitioner.setFootprintLocalized(footprint);
+        partitioner.setPlaneOrdering(ordering);
+
+        auto start = std::chrono::steady_clock::now();
+        partitioner.partition();
+        auto end = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        const auto& stats = partitioner.getStats();
+        std::cout << std::left << std::setw(28) << label
+                  << std::setw(10) << (footprint ? "footprint" : "full")
+                  << std::setw(11) << orderingName(ordering)
+                  << std::right << std::setw(7) << partitioner.getConvexCells().size()
+                  << std::setw(8) << stats.exactSplits
+                  << std::setw(8) << stats.skippedSplits
+                  << std::setw(12) << std::fixed << std::setprecision(1) << ms
+                  << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string dataPath = argc > 1 ? argv[1] : "../data";
+
+    std::cout << std::left << std::setw(28) << "input"
+              << std::setw(10) << "mode"
+              << std::setw(11) << "ordering"
+              << std::right << std::setw(7) << "cells"
+              << std::setw(8) << "splits"
+              << std::setw(8) << "skipped"
+              << std::setw(12) << "time [ms]" << std::endl;
+
+    std::vector<std::string> files;
+    if (fs::exists(dataPath)) {
+        for (const auto& entry : fs::directory_iterator(dataPath)) {
+            if (entry.path().extension() == ".contour") {
+                files.push_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto& file : files) {
+        auto planes = parseContourFile(file);
+        for (bool footprint : {false, true}) {
+            runOrderings(fs::path(file).stem().string(), planes, footprint);
+        }
+    }
+
+    for (int count : {4, 8, 12}) {
+        for (bool footprint : {false, true}) {
+            runOrderings("parallel x" + std::to_string(count), makeParallelStack(count), footprint);
+            runOrderings("oblique x" + std::to_string(count), makeObliqueStack(count), footprint);
+        }
+    }
+
+    return 0;
+}
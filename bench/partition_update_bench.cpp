@@ -0,0 +1,158 @@
+// partition_update_bench.cpp
+// Inserts the last contour of each file in the data directory into the
+// partition of the others, removes it again and checks that the cells,
+// the BSP tree and the adjacency stay consistent. Exits with 1 on the
+// first inconsistency.
+#include "partition.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+namespace fs = std::filesystem;
+
+namespace {
+
+// Returns an empty string when the partition is consistent, else what is wrong
+std::string checkPartition(const SpacePartitioner& partitioner, size_t contourCount) {
+    const auto& cells = partitioner.getConvexCells();
+    const auto& tree = partitioner.getTree();
+    size_t splitterCount = partitioner.getSplitPlanes().size();
+
+    // Every cell is the leaf of exactly one tree node
+    std::vector<int> leafCount(cells.size(), 0);
+    for (const auto& node : tree) {
+        if (node.splitter >= static_cast<int32_t>(splitterCount)) {
+            return "splitter index out of range";
+        }
+        if (node.splitter >= 0) {
+            if (node.below < 0 || node.above < 0 ||
+                node.below >= static_cast<int32_t>(tree.size()) ||
+                node.above >= static_cast<int32_t>(tree.size())) {
+                return "inner node without valid children";
+            }
+        } else if (node.cell >= static_cast<int32_t>(cells.size())) {
+            return "leaf cell index out of range";
+        } else if (node.cell >= 0) {
+            leafCount[node.cell]++;
+        }
+    }
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (leafCount[i] != 1) {
+            return "cell " + std::to_string(i) + " is in " + std::to_string(leafCount[i]) + " leaves";
+        }
+    }
+
+    // The tree locates each cell's centroid in that cell
+    for (size_t i = 0; i < cells.size(); ++i) {
+        Vector centroid(0, 0, 0);
+        for (const auto& p : cells[i].vertices) {
+            centroid = centroid + (p - CGAL::ORIGIN);
+        }
+        centroid = centroid / static_cast<double>(cells[i].vertices.size());
+        if (partitioner.locateCell(CGAL::ORIGIN + centroid) != static_cast<int>(i)) {
+            return "centroid of cell " + std::to_string(i) + " is located elsewhere";
+        }
+
+        for (const auto* indices : {&cells[i].planeIndices, &cells[i].facePlanes}) {
+            if (!std::is_sorted(indices->begin(), indices->end()) ||
+                (!indices->empty() && indices->back() >= contourCount)) {
+                return "contour indices of cell " + std::to_string(i) + " are invalid";
+            }
+        }
+    }
+
+    const auto& adjacency = partitioner.getAdjacency();
+    for (size_t e = 0; e < adjacency.size(); ++e) {
+        const auto& edge = adjacency[e];
+        if (edge.cellBelow >= cells.size() || edge.cellAbove >= cells.size() ||
+            edge.cellBelow == edge.cellAbove || edge.planeIndex >= contourCount) {
+            return "adjacency record " + std::to_string(e) + " is invalid";
+        }
+        for (size_t cell : {edge.cellBelow, edge.cellAbove}) {
+            const auto& edges = partitioner.getCellAdjacency(cell);
+            if (std::find(edges.begin(), edges.end(), e) == edges.end()) {
+                return "adjacency record " + std::to_string(e) + " is not indexed";
+            }
+        }
+    }
+    return "";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string dataPath = argc > 1 ? argv[1] : "../data";
+
+    std::vector<std::string> files;
+    if (fs::exists(dataPath)) {
+        for (const auto& entry : fs::directory_iterator(dataPath)) {
+            if (entry.path().extension() == ".contour") {
+                files.push_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::cout << std::left << std::setw(16) << "input"
+              << std::right << std::setw(7) << "cells"
+              << std::setw(9) << "+cells"
+              << std::setw(9) << "-cells"
+              << std::setw(8) << "faces"
+              << std::setw(13) << "insert [ms]"
+              << std::setw(13) << "remove [ms]" << std::endl;
+
+    for (const auto& file : files) {
+        std::string label = fs::path(file).stem().string();
+        auto planes = parseContourFile(file);
+        if (planes.size() < 2) continue;
+
+        ContourPlane inserted = planes.back();
+        planes.pop_back();
+
+        SpacePartitioner partitioner(planes);
+        partitioner.setCacheEnabled(false);
+        partitioner.partition();
+        size_t cellCount = partitioner.getConvexCells().size();
+        size_t faceCount = partitioner.getAdjacency().size();
+
+        auto start = std::chrono::steady_clock::now();
+        partitioner.insertPlane(inserted);
+        auto end = std::chrono::steady_clock::now();
+        double insertMs = std::chrono::duration<double, std::milli>(end - start).count();
+        size_t insertedCount = partitioner.getConvexCells().size();
+
+        std::string error = checkPartition(partitioner, planes.size() + 1);
+        if (!error.empty()) {
+            std::cerr << label << ": after insertPlane, " << error << std::endl;
+            return 1;
+        }
+
+        start = std::chrono::steady_clock::now();
+        partitioner.removePlane(planes.size());
+        end = std::chrono::steady_clock::now();
+        double removeMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+        error = checkPartition(partitioner, planes.size());
+        if (error.empty() && partitioner.getConvexCells().size() != cellCount) {
+            error = "cell count not restored";
+        }
+        if (error.empty() && partitioner.getAdjacency().size() != faceCount) {
+            error = "adjacency not restored";
+        }
+        if (!error.empty()) {
+            std::cerr << label << ": after removePlane, " << error << std::endl;
+            return 1;
+        }
+
+        std::cout << std::left << std::setw(16) << label
+                  << std::right << std::setw(7) << cellCount
+                  << std::setw(9) << insertedCount
+                  << std::setw(9) << partitioner.getConvexCells().size()
+                  << std::setw(8) << faceCount
+                  << std::setw(13) << std::fixed << std::setprecision(1) << insertMs
+                  << std::setw(13) << removeMs << std::endl;
+    }
+
+    return 0;
+}
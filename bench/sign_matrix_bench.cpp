@@ -0,0 +1,97 @@
+// sign_matrix_bench.cpp
+// Times the scalar and AVX2 sign matrix kernels on random planes and points
+// and checks that both produce the same matrix.
+#include "sign_matrix.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+namespace {
+
+void makeInput(size_t planeCount, size_t pointCount, PlanesSoA& planes, PointsSoA& points) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> coord(-100.0, 100.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    planes.clear();
+    for (size_t i = 0; i < planeCount; ++i) {
+        double a = normal(rng), b = normal(rng), c = normal(rng);
+        double length = std::sqrt(a * a + b * b + c * c);
+        planes.push_back(a / length, b / length, c / length, coord(rng));
+    }
+
+    // Every eighth point is put on the first plane to exercise the zero class
+    points.clear();
+    for (size_t i = 0; i < pointCount; ++i) {
+        double x = coord(rng), y = coord(rng), z = coord(rng);
+        if (i % 8 == 0) {
+            double d = planes.a[0] * x + planes.b[0] * y + planes.c[0] * z + planes.d[0];
+            x -= d * planes.a[0];
+            y -= d * planes.b[0];
+            z -= d * planes.c[0];
+        }
+        points.push_back(x, y, z);
+    }
+}
+
+double timeKernel(const PlanesSoA& planes, const PointsSoA& points, SignKernel kernel,
+                  SignMatrix& matrix, int repetitions) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        matrix.compute(planes, points, 1e-9, kernel);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+}
+
+} // namespace
+
+int main() {
+    std::cout << std::left << std::setw(8) << "planes"
+              << std::setw(10) << "points"
+              << std::right << std::setw(14) << "scalar [ms]"
+              << std::setw(14) << "avx2 [ms]"
+              << std::setw(10) << "speedup"
+              << std::setw(10) << "on plane"
+              << std::setw(8) << "match" << std::endl;
+
+    const size_t sizes[][2] = {{16, 1000}, {64, 10000}, {256, 10000}, {256, 100000}};
+    for (const auto& size : sizes) {
+        PlanesSoA planes;
+        PointsSoA points;
+        makeInput(size[0], size[1], planes, points);
+
+        SignMatrix scalar, avx2;
+        int repetitions = 10;
+        double scalarMs = timeKernel(planes, points, SignKernel::Scalar, scalar, repetitions);
+
+        std::cout << std::left << std::setw(8) << size[0]
+                  << std::setw(10) << size[1]
+                  << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(14) << scalarMs;
+
+        if (hasAvx2SignKernel()) {
+            double avx2Ms = timeKernel(planes, points, SignKernel::Avx2, avx2, repetitions);
+            bool match = true;
+            for (size_t p = 0; p < planes.size() && match; ++p) {
+                for (size_t i = 0; i < points.size() && match; ++i) {
+                    match = scalar.at(p, i) == avx2.at(p, i);
+                }
+            }
+            std::cout << std::setw(14) << avx2Ms
+                      << std::setw(10) << std::setprecision(2) << scalarMs / avx2Ms
+                      << std::setw(10) << scalar.count(0).onPlane
+                      << std::setw(8) << (match ? "yes" : "NO");
+        } else {
+            std::cout << std::setw(14) << "n/a"
+                      << std::setw(10) << "-"
+                      << std::setw(10) << scalar.count(0).onPlane
+                      << std::setw(8) << "-";
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
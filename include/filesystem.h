@@ -20,6 +20,8 @@ public:
     void nextFile();
     void previousFile();
     bool selectFile(size_t index);
+    // Reads the current file again, e.g. after it was edited
+    void reloadCurrentFile() { loadCurrentFile(); }
     std::vector<ContourPlane> getCurrentContours() const { return m_currentContours; }
     std::string getCurrentFileName() const { return m_files[m_currentIndex]; }
     size_t getCurrentIndex() const { return m_currentIndex; }
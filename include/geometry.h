@@ -0,0 +1,51 @@
+// geometry.h
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "contour.h"
+#include <vector>
+
+typedef InexactKernel::Point_2 Point2;
+typedef InexactKernel::Vector_2 Vector2;
+typedef InexactKernel::Vector_3 Vector;
+
+// Orthonormal 2D coordinate frame embedded in a 3D plane
+struct PlaneFrame {
+    Point origin;
+    Vector u, v, normal;
+
+    static PlaneFrame fromPlane(const Plane& plane);
+    Point2 to2d(const Point& p) const;
+    Point to3d(const Point2& p) const;
+};
+
+// Counter-clockwise convex hull of a 2D point set
+std::vector<Point2> convexHull2D(const std::vector<Point2>& points);
+
+// Offsets every edge of a counter-clockwise convex polygon outwards by margin
+std::vector<Point2> inflateConvexPolygon(const std::vector<Point2>& polygon, double margin);
+
+// Section of the convex polyhedron spanned by 'vertices' with 'plane', in
+// the coordinates of 'frame': the vertices within 'tolerance' of the plane
+// and the crossings of the edges between vertices on either side, as a
+// counter-clockwise convex hull
+std::vector<Point2> convexSection(const std::vector<Point>& vertices, const Plane& plane,
+                                  const PlaneFrame& frame, double tolerance);
+
+// Intersection of two counter-clockwise convex polygons
+std::vector<Point2> intersectConvexPolygons(const std::vector<Point2>& subject,
+                                            const std::vector<Point2>& clip);
+
+// Unsigned area of a simple polygon
+double polygonArea(const std::vector<Point2>& polygon);
+
+// Clips segment [a, b] against the convex region on the negative side of
+// every plane in 'faces' (unit normals pointing outwards), grown by
+// 'tolerance'. On success [tEnter, tExit] is the parameter range kept.
+bool clipSegmentToConvex(const std::vector<Plane>& faces, const Point& a, const Point& b,
+                         double tolerance, double& tEnter, double& tExit);
+
+// Separating axis test for two convex polygons (any orientation)
+bool convexPolygonsOverlap(const std::vector<Point2>& a, const std::vector<Point2>& b);
+
+#endif
@@ -4,39 +4,230 @@
 
 #include <CGAL/Nef_polyhedron_3.h>
 #include "contour.h"
+#include "geometry.h"
+#include "progress.h"
+#include <chrono>
+#include <memory>
 #include <set>
 
 typedef CGAL::Nef_polyhedron_3<ExactKernel> Nef_polyhedron;
 
 class SpacePartitioner {
 public:
+    enum class PlaneOrdering {
+        FileOrder,        // Planes in the order of the contour file
+        MostBalanced,     // Planes splitting the other contours most evenly first
+        FewestCrossings   // Planes crossing the fewest others inside the bounding box first
+    };
+
+    // Compact cell record; the exact polyhedron is rebuilt on demand with
+    // getExactGeometry()
     struct ConvexCell {
-        CGAL::Polyhedron_3<ExactKernel> geometry;
-        std::vector<size_t> planeIndices;  // Indices of defining planes
+        std::vector<Point> vertices;              // Double precision vertex positions
+        std::vector<std::vector<size_t>> faces;   // Vertex indices, counter-clockwise seen from outside
+        CGAL::Bbox_3 bbox;
+        std::vector<size_t> planeIndices;  // Contours crossing the cell
+        std::vector<size_t> facePlanes;    // Contour planes supporting a face of the cell
+    };
+
+    // Node of the binary space partition built by partition()
+    struct BSPNode {
+        int32_t splitter = -1;   // Index into getSplitPlanes(), -1 for leaves
+        int32_t below = -1;      // Child on the closed negative side of the splitter
+        int32_t above = -1;      // Child on the open positive side of the splitter
+        int32_t cell = -1;       // Leaf cell index, -1 if the leaf was filtered out
+        int32_t parent = -1;
+    };
+
+    // Two cells sharing a face on one of the splitting planes
+    struct CellAdjacency {
+        size_t cellBelow;          // Cell on the negative side of the plane
+        size_t cellAbove;          // Cell on the positive side of the plane
+        size_t planeIndex;         // Contour plane carrying the shared face
+        std::vector<Point> face;   // Shared face polygon
+        double area;
+    };
+
+    struct PartitionStats {
+        size_t exactSplits = 0;       // Splits that needed Nef intersections
+        size_t skippedSplits = 0;     // Splits settled by vertex classification
+        size_t exactPredicates = 0;   // Vertex tests the interval filter could not decide
+        size_t integerPredicates = 0; // Exact vertex tests settled in 128-bit integers
+        size_t footprintSkips = 0;    // Cuts skipped because the node misses the contour
+        size_t mergedPlanes = 0;      // Planes folded into a coplanar splitter
+        size_t peakRssKb = 0;         // Resident memory high-water mark during partition
+        size_t steadyRssKb = 0;       // Resident memory once the Nef state is released
     };
 
     SpacePartitioner(const std::vector<ContourPlane>& contourPlanes);
-    void partition();
+    // Token and callback only apply to this call; a cancelled partition
+    // throws OperationCancelled and leaves the partitioner unusable
+    void partition(const CancellationToken* token = nullptr, ProgressCallback progress = nullptr);
     bool loadConvexCells(const std::string& contourName);
     void saveConvexCells(const std::string& contourName) const;
     void renderPolyhedron(const ConvexCell& cell, bool highlight = false) const;
     const std::vector<ConvexCell>& getConvexCells() const { return m_cells; }
     std::vector<ContourPlane> getPlanesForCell(size_t cellIndex) const;
+    // Read-only snapshot of the contours, indexed by ConvexCell::planeIndices.
+    // Shared by all callers until the contours change.
+    std::shared_ptr<const std::vector<ContourPlane>> getContourStore() const;
+
+    // Outward unit face planes of a cell
+    static std::vector<Plane> computeFacePlanes(const ConvexCell& cell);
+    // Exact cell geometry, cut from the root box along the cell's tree path
+    ExactPolyhedron getExactGeometry(size_t cellIndex) const;
+
+    // Incremental updates: insertion splits only the cells the new plane
+    // crosses, removal rebuilds only the subtrees below the removed plane.
+    // Contour indices after a removed plane shift down by one.
+    void insertPlane(const ContourPlane& contourPlane);
+    bool removePlane(size_t contourIndex);
+    // Replaces the vertices and edges of a contour whose plane is unchanged.
+    // The cells stay as they are; only the incidence of this contour is
+    // recomputed. Returns the cells the contour crossed before or crosses now.
+    std::vector<size_t> updateContour(size_t contourIndex, const ContourPlane& contourPlane);
+
+    // Index of the cell containing p in O(depth), -1 outside of the partition
+    int locateCell(const Point& p) const;
+    std::vector<int> locateCells(const std::vector<Point>& points) const;
+    const std::vector<BSPNode>& getTree() const { return m_tree; }
+    const std::vector<Plane>& getSplitPlanes() const { return m_splitPlanes; }
+
+    // Face adjacency between cells; getCellAdjacency lists the indices of
+    // the adjacency records touching one cell
+    const std::vector<CellAdjacency>& getAdjacency() const { return m_adjacency; }
+    const std::vector<size_t>& getCellAdjacency(size_t cellIndex) const { return m_cellAdjacency[cellIndex]; }
+
+    // Maximum number of pending nodes kept as live Nef polyhedra during the
+    // traversal; nodes beyond the cap are parked as plain polyhedra (0 = no cap)
+    void setMaxInFlightNodes(size_t maxNodes) { m_maxInFlightNodes = maxNodes; }
+    size_t getMaxInFlightNodes() const { return m_maxInFlightNodes; }
+    const PartitionStats& getStats() const { return m_stats; }
+
+    // Cut a node with a plane only where it meets that plane's contour
+    // footprint (convex hull of the contour grown by 'inflation')
+    void setFootprintLocalized(bool enabled, double inflation = 0.0);
+    bool isFootprintLocalized() const { return m_footprintLocalized; }
+
+    void setPlaneOrdering(PlaneOrdering ordering) { m_planeOrdering = ordering; }
+    PlaneOrdering getPlaneOrdering() const { return m_planeOrdering; }
+    // Contour indices behind each splitting plane, in the order they are applied
+    const std::vector<std::vector<size_t>>& getPlaneSources() const { return m_planeSources; }
+
+    // Planes within this tolerance (unit normal difference, and offset
+    // difference relative to the bounding box diagonal) are merged into one
+    // splitter; exactly identical planes are always merged
+    void setCoplanarTolerance(double tolerance) { m_coplanarTolerance = tolerance; }
+
+    // Disables reading and writing the convex cell cache (benchmarks)
+    void setCacheEnabled(bool enabled) { m_cacheEnabled = enabled; }
+
+    // Partition on planes with integer normals and offsets on a grid of
+    // 'spacing' (rounded to a power of two), so that exact predicates fit in
+    // fixed-width integers. The contours keep their input vertices and
+    // planes. Takes effect on the next partition().
+    void setIntegerSnapping(bool enabled, double spacing = 1.0 / 64);
+    bool isIntegerSnapping() const { return m_integerSnapping; }
+    // Largest distance of a contour vertex from the plane its contour was
+    // partitioned on, 0 without snapping
+    double getSnapError() const { return m_snapError; }
+
+    // Seconds between checkpoints of a running partition, written to the
+    // cache directory; 0 disables checkpointing
+    void setCheckpointInterval(double seconds) { m_checkpointInterval = seconds; }
 
 private:
+    // Pending node of the partition traversal
+    struct PartitionNode {
+        Nef_polyhedron space;
+        ExactPolyhedron parked;      // Compact copy while the Nef is released
+        bool isParked = false;
+        size_t planeIndex = 0;
+        int32_t treeNode = 0;
+        std::set<size_t> planes;     // Planes that cut this node so far
+        double weight = 1.0;         // Share of the root, for progress
+        bool isDeferred = false;     // Region not built yet (resumed from a checkpoint)
+    };
+
+    void computePartition();
     std::string getConvexCellsPath(const std::string& contourName) const;
     void ensureDirectoryExists(const std::string& path) const;
-    std::vector<ExactKernel::Plane_3> m_exactPlanes;
+    void saveTree(const std::string& path) const;
+    bool loadTree(const std::string& path);
+    void saveAdjacency(const std::string& path) const;
+    bool loadAdjacency(const std::string& path);
+    void buildAdjacency();
+    void linkCells(const std::vector<size_t>& cells, const std::vector<bool>& isNew);
+    void indexAdjacency();
+    std::vector<ExactKernel::Plane_3> m_exactPlanes;  // Splitting planes in application order
+    std::vector<std::vector<size_t>> m_planeSources;   // Contour indices of each entry in m_exactPlanes
     void precomputePlanes();
-    void partitionSpace(Nef_polyhedron& space, 
-                       size_t planeIndex,
-                       std::vector<std::pair<Nef_polyhedron, std::set<size_t>>>& nefPolys);
+    void mergeCoplanarPlanes();
+    void orderPlanes();
+    void partitionSpace(Nef_polyhedron root,
+                        int32_t rootNode,
+                        const std::vector<size_t>& splitters,
+                        const std::set<size_t>& rootPlanes);
+    void traverseNodes(std::vector<PartitionNode>& stack,
+                       const std::vector<size_t>& splitters,
+                       double finishedWeight);
+    void traverseStack(std::vector<PartitionNode>& stack,
+                       const std::vector<size_t>& splitters,
+                       double& finishedWeight);
+    void ensureExactPlanes();
+    Nef_polyhedron materializeNode(int32_t treeNode) const;
+    std::set<size_t> pathPlanes(int32_t treeNode) const;
+    void replaceCells(std::vector<bool> deadCells, size_t firstNewCell);
+    std::vector<int32_t> compactPartition(const std::vector<bool>& deadCells);
+    void computeIncidence();
+    void computeIncidence(const std::vector<size_t>& cells);
+    CGAL::Oriented_side classifyNode(const Nef_polyhedron& space,
+                                     const ExactKernel::Plane_3& plane);
+    void precomputeFootprints();
+    bool nodeTouchesFootprint(const Nef_polyhedron& space, size_t contourIndex) const;
+    bool nodeTouchesAnyFootprint(const Nef_polyhedron& space, size_t planeIndex) const;
+    void parkNodes(std::vector<PartitionNode>& stack, size_t& liveNodes) const;
+    void emitCell(const Nef_polyhedron& space, const std::set<size_t>& planes);
+    void filterElementaryCells();
     Nef_polyhedron computeBoundingBox() const;
     std::pair<Point, Point> getBBoxCorners() const;
+    Plane snapPlane(const ContourPlane& contourPlane) const;
+    void computePartitionPlanes();
+    double contourTolerance() const;
     
     std::vector<ConvexCell> m_cells;
     std::vector<ContourPlane> m_contourPlanes;
-    Nef_polyhedron m_partitionedSpace;
+    mutable std::shared_ptr<const std::vector<ContourPlane>> m_contourStore;  // Snapshot of m_contourPlanes
+    std::vector<BSPNode> m_tree;
+    std::vector<Plane> m_splitPlanes;            // Splitting planes referenced by m_tree
+    std::pair<Point, Point> m_treeBounds;        // Box covered by the tree root
+    std::vector<size_t> m_splitContours;         // Contour index of each split plane
+    std::vector<CellAdjacency> m_adjacency;
+    std::vector<std::vector<size_t>> m_cellAdjacency;
+    size_t m_maxInFlightNodes = 0;
+    PartitionStats m_stats;
+    bool m_footprintLocalized = false;
+    double m_footprintInflation = 0.0;
+    std::vector<PlaneFrame> m_footprintFrames;
+    std::vector<std::vector<Point2>> m_footprints;
+    PlaneOrdering m_planeOrdering = PlaneOrdering::FileOrder;
+    bool m_cacheEnabled = true;
+    double m_coplanarTolerance = 1e-6;
+    bool m_integerSnapping = false;
+    double m_gridSpacing = 1.0 / 64;
+    std::vector<Plane> m_partitionPlanes;  // Plane each contour is partitioned on, snapped or as input
+    double m_snapError = 0.0;
+    ProgressReporter m_progress;
+
+    // Checkpoint of the running partition(), empty path when disabled
+    std::string m_checkpointPath;
+    double m_checkpointInterval = 60.0;
+    uint64_t m_checkpointFingerprint = 0;
+    std::chrono::steady_clock::time_point m_lastCheckpoint;
+    uint64_t computeFingerprint() const;
+    uint64_t computeCacheFingerprint() const;
+    void writeCheckpoint(const std::vector<PartitionNode>& stack, double finishedWeight) const;
+    bool loadCheckpoint(std::vector<PartitionNode>& stack, double& finishedWeight);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,69 @@
+// progress.h
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+
+// Thrown out of a long computation once its cancellation token is set
+class OperationCancelled : public std::runtime_error {
+public:
+    OperationCancelled() : std::runtime_error("Operation cancelled") {}
+};
+
+// Flag shared between a computation and the thread that may abort it
+class CancellationToken {
+public:
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> m_cancelled{false};
+};
+
+// Receives the completed fraction of a computation, in [0, 1]
+typedef std::function<void(double)> ProgressCallback;
+
+// Cancellation checks and progress reports of one computation. Work is
+// split into phases; the fraction reported for the current phase is mapped
+// into the phase's share of the whole. Token and callback are optional.
+class ProgressReporter {
+public:
+    ProgressReporter() = default;
+    ProgressReporter(const CancellationToken* token, ProgressCallback callback)
+        : m_token(token), m_callback(std::move(callback)) {}
+
+    void setPhase(double begin, double end) {
+        m_begin = begin;
+        m_end = end;
+        report(0.0);
+    }
+
+    void checkCancelled() const {
+        if (m_token && m_token->isCancelled()) {
+            throw OperationCancelled();
+        }
+    }
+
+    // Also a cancellation point; reports are throttled to steps of 0.1%
+    void report(double phaseFraction) {
+        checkCancelled();
+        if (!m_callback) return;
+
+        double fraction = m_begin + (m_end - m_begin) * phaseFraction;
+        if (fraction - m_lastReported >= 0.001 || fraction >= 1.0) {
+            m_lastReported = fraction;
+            m_callback(fraction);
+        }
+    }
+
+private:
+    const CancellationToken* m_token = nullptr;
+    ProgressCallback m_callback;
+    double m_begin = 0.0;
+    double m_end = 1.0;
+    double m_lastReported = -1.0;
+};
+
+#endif
@@ -4,7 +4,8 @@
 
 #include "contour.h"
 #include "partition.h"
-#include <unordered_map>
+#include "progress.h"
+#include "reconstruction.h"
 #include <CGAL/Advancing_front_surface_reconstruction.h>
 #include <CGAL/Surface_mesh.h>
 #include <CGAL/Triangulation_3.h>
@@ -22,16 +23,14 @@ struct AxisPlanes {
     std::vector<Plane> planes;
 };
 
-struct ReconstructedMesh {
-    CGAL::Surface_mesh<Point> mesh;
-    std::vector<Point> vertices;
-    std::vector<std::array<size_t, 3>> triangles;
-};
-
+// Refers to its contour and axis plane by index, into the contour store and
+// the axis planes of its cell, so projections can be moved and cached freely
 struct ProjectedContour {
-    const ContourPlane* originalPlane;
-    const AxisPlanes::Plane* projectionPlane;
-    std::vector<Point> projectedVertices;
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    size_t contourIndex = npos;
+    size_t projectionPlaneIndex = npos;  // npos for extended meshes
+    std::vector<Point> clippedVertices;    // Part of the contour inside the cell
+    std::vector<Point> projectedVertices;  // clippedVertices projected, in the same order
     ReconstructedMesh reconstructedSurface;
     bool useExtendedMesh = false;
 };
@@ -43,38 +42,63 @@ struct CellProjections {
 
 class Projection {
 public:
-    Projection(const SpacePartitioner& partitioner);
+    // A cancelled construction throws OperationCancelled
+    Projection(const SpacePartitioner& partitioner,
+               const CancellationToken* token = nullptr,
+               ProgressCallback progress = nullptr,
+               ReconstructionMethod method = ReconstructionMethod::PlanarCDT);
     
+    // Re-projects only the cells that depend on the changed contours, after
+    // the partitioner took the edits with updateContour. Cells and axis
+    // planes are unchanged; a cancelled update throws OperationCancelled and
+    // leaves the previous projections in place. Returns the number of cells
+    // re-projected.
+    size_t updateContours(const SpacePartitioner& partitioner,
+                          const std::vector<size_t>& changedContours,
+                          const CancellationToken* token = nullptr,
+                          ProgressCallback progress = nullptr);
+
     size_t getCellCount() const { return m_cells.size(); }
     const std::vector<SpacePartitioner::ConvexCell>& getCells() const { return m_cells; }
     std::vector<ContourPlane> getPlanesForCell(size_t cellIndex) const;
     void debugPrintCellInfo() const;
     void renderPlanesForAllCells() const;
     const AxisPlanes& getAxisPlanesForCell(size_t cellIndex) const;
-    void renderPlanesForCell(const CGAL::Polyhedron_3<ExactKernel>& poly) const;
+    const ContourPlane& getContour(const ProjectedContour& projection) const;
+    // Null for projections without an axis plane
+    const AxisPlanes::Plane* getProjectionPlane(size_t cellIndex,
+                                                const ProjectedContour& projection) const;
+    void renderPlanesForCell(size_t cellIndex) const;
     void renderAllReconstructions() const;
 
 private:
     std::vector<SpacePartitioner::ConvexCell> m_cells;
-    std::vector<ContourPlane> m_contourPlanes;
-    std::unordered_map<size_t, AxisPlanes> m_cellPlanes;
-    std::vector<CellProjections> m_projectedContours;
+    std::shared_ptr<const std::vector<ContourPlane>> m_contours;  // Shared with the partitioner
+    std::vector<AxisPlanes> m_cellPlanes;  // Indexed by cell, derived from the cell box only
+    std::vector<CellProjections> m_projectedContours;  // Indexed by cell
+    std::vector<std::vector<size_t>> m_contourCells;   // Cells whose projections read each contour
+    double m_snapError = 0.0;  // Distance of the contours from the cell faces they lie on
+    ReconstructionMethod m_method;
 
     ReconstructedMesh reconstructCellSurface(
     const std::vector<Point>& originalVertices,
-    const std::vector<Point>& projectedVertices) const;
+    const std::vector<Point>& projectedVertices,
+    const std::vector<std::pair<int, int>>& edges) const;
     ReconstructedMesh convertExtendedToReconstructedMesh(const ExtendedMesh& extMesh) const;
     ReconstructedMesh triangulateVertices(const std::vector<Point>& vertices) const;
-    void reconstructSurface(ProjectedContour& projection);
+    void reconstructSurface(ProjectedContour& projection, const std::vector<std::pair<int, int>>& edges);
     void renderReconstructedSurface(const ReconstructedMesh& mesh) const;
     double computePlaneDotProduct(const Plane& contourPlane, 
                                 const AxisPlanes::Plane& axisPlane) const;
-    const AxisPlanes::Plane* selectProjectionPlane(const ContourPlane& contourPlane,
-                                                 const AxisPlanes& axisPlanes) const;
+    // Index into axisPlanes.planes, or ProjectedContour::npos
+    size_t selectProjectionPlane(const ContourPlane& contourPlane,
+                                 const AxisPlanes& axisPlanes) const;
     std::vector<Point> projectVerticesOntoPlane(const std::vector<Point>& vertices,
                                               const AxisPlanes::Plane& plane) const;
-    void computeProjections();
-    AxisPlanes computeAxisAlignedPlanes(const CGAL::Polyhedron_3<ExactKernel>& poly) const;
+    void computeProjections(const std::vector<size_t>& cells, ProgressReporter& progress);
+    void buildContourCells();
+    CellProjections projectCell(size_t cellIndex) const;
+    AxisPlanes computeAxisAlignedPlanes(const CGAL::Bbox_3& bbox) const;
     void renderAxisPlanes(const AxisPlanes& planes) const;
 };
 
@@ -0,0 +1,116 @@
+// reconstruction.h
+#ifndef RECONSTRUCTION_H
+#define RECONSTRUCTION_H
+
+#include "contour.h"
+#include "geometry.h"
+#include <array>
+#include <limits>
+#include <list>
+#include <memory>
+#include <vector>
+#include <CGAL/Constrained_Delaunay_triangulation_2.h>
+#include <CGAL/Constrained_triangulation_face_base_2.h>
+#include <CGAL/Surface_mesh.h>
+#include <CGAL/Triangulation_3.h>
+#include <CGAL/Triangulation_cell_base_3.h>
+#include <CGAL/Triangulation_face_base_with_info_2.h>
+#include <CGAL/Triangulation_vertex_base_with_info_2.h>
+#include <CGAL/Triangulation_vertex_base_with_info_3.h>
+
+// Triangulation whose vertices know the index of the input point they hold
+typedef CGAL::Triangulation_vertex_base_with_info_3<size_t, InexactKernel> IndexedVertexBase;
+typedef CGAL::Triangulation_data_structure_3<IndexedVertexBase,
+                                             CGAL::Triangulation_cell_base_3<InexactKernel>> IndexedTds;
+typedef CGAL::Triangulation_3<InexactKernel, IndexedTds> IndexedTriangulation;
+
+// Constrained Delaunay triangulation of a contour in its plane. Vertices
+// carry the index of their mesh vertex, npos for points created where
+// constraints cross; faces carry their nesting level inside the contour.
+struct PlanarVertexInfo {
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+    size_t index = npos;
+};
+struct PlanarFaceInfo {
+    int nestingLevel = -1;
+    bool inDomain() const { return nestingLevel % 2 == 1; }
+};
+typedef CGAL::Triangulation_vertex_base_with_info_2<PlanarVertexInfo, InexactKernel> PlanarVertexBase;
+typedef CGAL::Constrained_triangulation_face_base_2<InexactKernel> PlanarConstrainedFaceBase;
+typedef CGAL::Triangulation_face_base_with_info_2<PlanarFaceInfo, InexactKernel,
+                                                  PlanarConstrainedFaceBase> PlanarFaceBase;
+typedef CGAL::Triangulation_data_structure_2<PlanarVertexBase, PlanarFaceBase> PlanarTds;
+typedef CGAL::Constrained_Delaunay_triangulation_2<InexactKernel, PlanarTds,
+                                                   CGAL::Exact_predicates_tag> PlanarCDT;
+
+enum class ReconstructionMethod {
+    Tetrahedral,   // 3D triangulation of the contour and projected points
+    PlanarCDT      // Constrained caps in both planes joined along the contour edges
+};
+
+// The flat vertex and triangle arrays are the mesh; the half-edge
+// Surface_mesh is only built for consumers that need it and is kept until
+// the arrays change.
+struct ReconstructedMesh {
+    std::vector<Point> vertices;
+    std::vector<std::array<size_t, 3>> triangles;
+    size_t mergedDuplicates = 0;  // Input points equal to an earlier one, unused by the triangles
+    size_t interiorFacets = 0;    // Triangulation facets dropped as not on the surface
+
+    // Vertex i of the mesh is vertices[i]. Not thread safe on first use.
+    const CGAL::Surface_mesh<Point>& surfaceMesh() const;
+    // Must be called after changing vertices or triangles
+    void invalidateSurfaceMesh() { cachedSurfaceMesh.reset(); }
+
+private:
+    mutable std::shared_ptr<const CGAL::Surface_mesh<Point>> cachedSurfaceMesh;
+};
+
+// Triangulates point sets into ReconstructedMesh results, writing the
+// triangles straight into the result. Clearing a triangulation frees its
+// cells, so only the small index buffers keep their capacity between
+// calls. An engine is not thread safe; use one per thread, e.g.
+// forThisThread().
+class ReconstructionEngine {
+public:
+    // Convex hull facets of the triangulation of 'points'
+    void triangulate(const std::vector<Point>& points, ReconstructedMesh& result);
+    // Points of 'first' followed by those of 'second', taken as a contour
+    // and its projection: point i of 'second' is the image of point i of
+    // 'first', and 'edges' joins points of 'first' (empty for one closed
+    // ring in order). Keeps the hull facets and the facets joining the
+    // contour and its projection along such a pair and one of its edges.
+    void triangulate(const std::vector<Point>& first, const std::vector<Point>& second,
+                     const std::vector<std::pair<int, int>>& edges, ReconstructedMesh& result);
+
+    // Caps of the contour and of its projection, each triangulated in its
+    // own plane with the contour edges as constraints, joined by a band of
+    // quads along the edges. 'projected' holds the contour vertices
+    // projected onto 'projectionPlane', in the same order.
+    void triangulateContour(const ContourPlane& contour, const std::vector<Point>& projected,
+                            const Plane& projectionPlane, ReconstructedMesh& result);
+    // Same for a contour given by its plane, vertices and edges
+    void triangulateContour(const Plane& plane, const std::vector<Point>& vertices,
+                            const std::vector<std::pair<int, int>>& edges,
+                            const std::vector<Point>& projected, const Plane& projectionPlane,
+                            ReconstructedMesh& result);
+
+    static ReconstructionEngine& forThisThread();
+
+private:
+    IndexedTriangulation m_triangulation;
+    PlanarCDT m_cdt;
+    std::vector<PlanarCDT::Vertex_handle> m_cdtVertices;
+    std::vector<std::pair<int, int>> m_edges;
+
+    std::vector<std::pair<size_t, size_t>> m_edgeKeys;  // Sorted (low, high) contour edges
+
+    void triangulateVertices(size_t contourSize, ReconstructedMesh& result);
+    bool isSurfaceFacet(const IndexedTriangulation::Facet& facet, const std::array<size_t, 3>& triangle,
+                        size_t contourSize) const;
+    void triangulateCap(const std::vector<Point>& vertices, size_t offset, const PlaneFrame& frame,
+                        bool flip, ReconstructedMesh& result);
+    void markDomains();
+};
+
+#endif
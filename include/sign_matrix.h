@@ -0,0 +1,68 @@
+// sign_matrix.h
+#ifndef SIGN_MATRIX_H
+#define SIGN_MATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Point coordinates in structure-of-arrays layout
+struct PointsSoA {
+    std::vector<double> x, y, z;
+
+    size_t size() const { return x.size(); }
+    void reserve(size_t n);
+    void clear();
+    void push_back(double px, double py, double pz);
+};
+
+// Planes a*x + b*y + c*z + d = 0, one array per coefficient
+struct PlanesSoA {
+    std::vector<double> a, b, c, d;
+
+    size_t size() const { return a.size(); }
+    void reserve(size_t n);
+    void clear();
+    void push_back(double pa, double pb, double pc, double pd);
+};
+
+enum class SignKernel {
+    Auto,    // AVX2 when the CPU supports it, scalar otherwise
+    Scalar,
+    Avx2
+};
+
+// True when the AVX2 kernel is compiled in and the CPU supports it
+bool hasAvx2SignKernel();
+
+// Side of every point with respect to every plane, stored row-major by
+// plane: +1 positive side, -1 negative side, 0 on the plane. A point is on
+// the plane when the evaluated value is within 'tolerance' (in plane units,
+// a distance for unit normals) plus the rounding error bound of the
+// evaluation, so the nonzero entries are certain.
+class SignMatrix {
+public:
+    void compute(const PlanesSoA& planes, const PointsSoA& points, double tolerance = 0.0,
+                 SignKernel kernel = SignKernel::Auto);
+
+    size_t planeCount() const { return m_planes; }
+    size_t pointCount() const { return m_points; }
+    int8_t at(size_t plane, size_t point) const { return m_signs[plane * m_points + point]; }
+    const int8_t* row(size_t plane) const { return m_signs.data() + plane * m_points; }
+
+    // Entries of one row in [begin, end) per class
+    struct Counts {
+        size_t positive = 0;
+        size_t negative = 0;
+        size_t onPlane = 0;
+    };
+    Counts count(size_t plane, size_t begin, size_t end) const;
+    Counts count(size_t plane) const { return count(plane, 0, m_points); }
+
+private:
+    std::vector<int8_t> m_signs;
+    size_t m_planes = 0;
+    size_t m_points = 0;
+};
+
+#endif
@@ -0,0 +1,186 @@
+// geometry.cpp
+#include "geometry.h"
+#include <CGAL/convex_hull_2.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PlaneFrame PlaneFrame::fromPlane(const Plane& plane) {
+    PlaneFrame frame;
+    frame.origin = plane.point();
+    frame.normal = plane.orthogonal_vector();
+    frame.normal = frame.normal / std::sqrt(frame.normal.squared_length());
+    frame.u = plane.base1();
+    frame.u = frame.u / std::sqrt(frame.u.squared_length());
+    frame.v = CGAL::cross_product(frame.normal, frame.u);
+    return frame;
+}
+
+Point2 PlaneFrame::to2d(const Point& p) const {
+    Vector d = p - origin;
+    return Point2(d * u, d * v);
+}
+
+Point PlaneFrame::to3d(const Point2& p) const {
+    return origin + p.x() * u + p.y() * v;
+}
+
+std::vector<Point2> convexHull2D(const std::vector<Point2>& points) {
+    std::vector<Point2> hull;
+    CGAL::convex_hull_2(points.begin(), points.end(), std::back_inserter(hull));
+    return hull;
+}
+
+std::vector<Point2> inflateConvexPolygon(const std::vector<Point2>& polygon, double margin) {
+    if (polygon.size() < 3 || margin <= 0.0) return polygon;
+
+    // Outward unit normal of each edge of the counter-clockwise polygon
+    std::vector<Vector2> normals;
+    normals.reserve(polygon.size());
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        Vector2 edge = polygon[(i + 1) % polygon.size()] - polygon[i];
+        normals.push_back(Vector2(edge.y(), -edge.x()) / std::sqrt(edge.squared_length()));
+    }
+
+    // Each edge moves out by margin along its normal; a vertex goes to the
+    // crossing of the two offset edges next to it, which lies along the
+    // bisector n1 + n2 at margin / cos(half the turn angle)
+    std::vector<Point2> inflated;
+    inflated.reserve(polygon.size());
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        const Vector2& before = normals[(i + polygon.size() - 1) % polygon.size()];
+        const Vector2& after = normals[i];
+        inflated.push_back(polygon[i] + (before + after) * (margin / (1.0 + before * after)));
+    }
+    return inflated;
+}
+
+std::vector<Point2> convexSection(const std::vector<Point>& vertices, const Plane& plane,
+                                  const PlaneFrame& frame, double tolerance) {
+    double norm = std::sqrt(plane.orthogonal_vector().squared_length());
+    std::vector<double> distances;
+    distances.reserve(vertices.size());
+    for (const auto& p : vertices) {
+        distances.push_back((plane.a() * p.x() + plane.b() * p.y() + plane.c() * p.z() + plane.d()) / norm);
+    }
+
+    // The polyhedron is convex, so the crossings of all vertex pairs span
+    // exactly its section with the plane
+    std::vector<Point2> section;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        if (std::abs(distances[i]) <= tolerance) {
+            section.push_back(frame.to2d(vertices[i]));
+            continue;
+        }
+        for (size_t j = i + 1; j < vertices.size(); ++j) {
+            if (std::abs(distances[j]) <= tolerance || (distances[i] < 0.0) == (distances[j] < 0.0)) continue;
+
+            double t = distances[i] / (distances[i] - distances[j]);
+            section.push_back(frame.to2d(vertices[i] + t * (vertices[j] - vertices[i])));
+        }
+    }
+    return convexHull2D(section);
+}
+
+std::vector<Point2> intersectConvexPolygons(const std::vector<Point2>& subject,
+                                            const std::vector<Point2>& clip) {
+    // Sutherland-Hodgman: clip the subject against each edge of 'clip'
+    std::vector<Point2> output = subject;
+    for (size_t i = 0; i < clip.size() && !output.empty(); ++i) {
+        const Point2& a = clip[i];
+        const Point2& b = clip[(i + 1) % clip.size()];
+        auto side = [&a, &b](const Point2& p) {
+            return (b.x() - a.x()) * (p.y() - a.y()) - (b.y() - a.y()) * (p.x() - a.x());
+        };
+
+        std::vector<Point2> input;
+        input.swap(output);
+        for (size_t j = 0; j < input.size(); ++j) {
+            const Point2& p = input[j];
+            const Point2& q = input[(j + 1) % input.size()];
+            double sp = side(p);
+            double sq = side(q);
+
+            if (sp >= 0.0) {
+                output.push_back(p);
+            }
+            if ((sp >= 0.0) != (sq >= 0.0)) {
+                double t = sp / (sp - sq);
+                output.emplace_back(p.x() + t * (q.x() - p.x()), p.y() + t * (q.y() - p.y()));
+            }
+        }
+    }
+    return output;
+}
+
+double polygonArea(const std::vector<Point2>& polygon) {
+    double area = 0.0;
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        const Point2& p = polygon[i];
+        const Point2& q = polygon[(i + 1) % polygon.size()];
+        area += p.x() * q.y() - q.x() * p.y();
+    }
+    return std::abs(area) * 0.5;
+}
+
+bool clipSegmentToConvex(const std::vector<Plane>& faces, const Point& a, const Point& b,
+                         double tolerance, double& tEnter, double& tExit) {
+    // Cyrus-Beck: each face bounds the parameter range from one side
+    tEnter = 0.0;
+    tExit = 1.0;
+    for (const auto& face : faces) {
+        double da = face.a() * a.x() + face.b() * a.y() + face.c() * a.z() + face.d() - tolerance;
+        double db = face.a() * b.x() + face.b() * b.y() + face.c() * b.z() + face.d() - tolerance;
+
+        if (da > 0.0 && db > 0.0) return false;
+        if (da <= 0.0 && db <= 0.0) continue;
+
+        double t = da / (da - db);
+        if (da > 0.0) {
+            tEnter = std::max(tEnter, t);
+        } else {
+            tExit = std::min(tExit, t);
+        }
+        if (tEnter > tExit) return false;
+    }
+    return true;
+}
+
+namespace {
+
+// True if some edge normal of 'poly' separates the two point sets
+bool hasSeparatingAxis(const std::vector<Point2>& poly,
+                       const std::vector<Point2>& a,
+                       const std::vector<Point2>& b) {
+    for (size_t i = 0; i < poly.size(); ++i) {
+        const Point2& p = poly[i];
+        const Point2& q = poly[(i + 1) % poly.size()];
+        double ax = -(q.y() - p.y());
+        double ay = q.x() - p.x();
+
+        double minA = std::numeric_limits<double>::max(), maxA = -minA;
+        for (const auto& pt : a) {
+            double d = pt.x() * ax + pt.y() * ay;
+            minA = std::min(minA, d);
+            maxA = std::max(maxA, d);
+        }
+        double minB = std::numeric_limits<double>::max(), maxB = -minB;
+        for (const auto& pt : b) {
+            double d = pt.x() * ax + pt.y() * ay;
+            minB = std::min(minB, d);
+            maxB = std::max(maxB, d);
+        }
+
+        if (maxA < minB || maxB < minA) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool convexPolygonsOverlap(const std::vector<Point2>& a, const std::vector<Point2>& b) {
+    if (a.empty() || b.empty()) return false;
+    return !hasSeparatingAxis(a, a, b) && !hasSeparatingAxis(b, a, b);
+}
@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <GL/glew.h>
 #include <GL/freeglut.h>
@@ -12,6 +18,55 @@
 // Global state variables
 bool g_showConvexCells = false;
 bool g_showSurfaceMeshes = false;
+bool g_footprintPartition = false;
+bool g_integerSnapping = false;
+bool g_rebuildRequested = false;
+bool g_reloadRequested = false;
+
+// Partition and projection of one file, computed off the render thread
+struct RebuildResult {
+    std::vector<ContourPlane> contours;
+    std::unique_ptr<SpacePartitioner> partitioner;
+    std::unique_ptr<Projection> projection;
+};
+
+struct RebuildJob {
+    std::string fileName;
+    CancellationToken token;
+    std::atomic<double> progress{0.0};
+    std::future<RebuildResult> result;
+};
+
+std::unique_ptr<RebuildJob> g_rebuildJob;                  // Job whose result will be shown
+std::vector<std::unique_ptr<RebuildJob>> g_cancelledJobs;  // Superseded jobs still winding down
+
+std::unique_ptr<RebuildJob> startRebuild(std::vector<ContourPlane> contours, const std::string& fileName) {
+    auto job = std::make_unique<RebuildJob>();
+    job->fileName = fileName;
+
+    // The job outlives its worker: it is only destroyed once the future is ready
+    RebuildJob* state = job.get();
+    bool footprint = g_footprintPartition;
+    bool snapping = g_integerSnapping;
+    job->result = std::async(std::launch::async, [state, footprint, snapping, contours = std::move(contours)]() mutable {
+        RebuildResult result;
+        result.partitioner = std::make_unique<SpacePartitioner>(contours);
+        result.partitioner->setFootprintLocalized(footprint);
+        result.partitioner->setIntegerSnapping(snapping);
+
+        // Partition takes the first 70% of the bar, projection the rest
+        result.partitioner->partition(&state->token, [state](double fraction) {
+            state->progress = 0.7 * fraction;
+        });
+        result.projection = std::make_unique<Projection>(*result.partitioner, &state->token,
+            [state](double fraction) {
+                state->progress = 0.7 + 0.3 * fraction;
+            });
+        result.contours = std::move(contours);
+        return result;
+    });
+    return job;
+}
 
 // Text rendering helpers
 void renderText(const std::string& text, float x, float y) {
@@ -49,10 +104,18 @@ void renderHelpOverlay() {
        << "1-9: Select file directly" << std::endl
        << "C: Toggle convex cells (" << (g_showConvexCells ? "ON" : "OFF") << ")" << std::endl
        << "S: Toggle surface meshes (" << (g_showSurfaceMeshes ? "ON" : "OFF") << ")" << std::endl
+       << "F: Toggle footprint partition (" << (g_footprintPartition ? "ON" : "OFF") << ")" << std::endl
+       << "G: Toggle integer grid snapping (" << (g_integerSnapping ? "ON" : "OFF") << ")" << std::endl
+       << "R: Reload current file" << std::endl
        << "Mouse: Look around" << std::endl
        << "Scroll: Zoom" << std::endl
        << "ESC: Exit";
 
+    if (g_rebuildJob) {
+        ss << std::endl << "Computing " << g_rebuildJob->fileName << ": "
+           << std::fixed << std::setprecision(0) << 100.0 * g_rebuildJob->progress << "%";
+    }
+
     float y = 20.0f;
     std::string line;
     std::istringstream iss(ss.str());
@@ -71,6 +134,17 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             case GLFW_KEY_S:
                 g_showSurfaceMeshes = !g_showSurfaceMeshes;
                 break;
+            case GLFW_KEY_F:
+                g_footprintPartition = !g_footprintPartition;
+                g_rebuildRequested = true;
+                break;
+            case GLFW_KEY_G:
+                g_integerSnapping = !g_integerSnapping;
+                g_rebuildRequested = true;
+                break;
+            case GLFW_KEY_R:
+                g_reloadRequested = true;
+                break;
             case GLFW_KEY_ESCAPE:
                 glfwSetWindowShouldClose(window, GLFW_TRUE);
                 break;
@@ -106,6 +180,8 @@ int main() {
 
         try {
             partitioner = new SpacePartitioner(contourPlanes);
+            partitioner->setFootprintLocalized(g_footprintPartition);
+            partitioner->setIntegerSnapping(g_integerSnapping);
             partitioner->partition();
             projection = new Projection(*partitioner);
         }
@@ -175,22 +251,49 @@ int main() {
                         }
                     }
 
-                    if (fileChanged) {
+                    // A reload that only moves contour vertices within their
+                    // planes keeps the partition and re-projects the cells
+                    // reading the edited contours
+                    if (g_reloadRequested) {
+                        g_reloadRequested = false;
+                        fs.reloadCurrentFile();
                         std::vector<ContourPlane> newContours = fs.getCurrentContours();
-                        if (!newContours.empty()) {
-                            contourPlanes = std::move(newContours);
-                            delete partitioner;
-                            partitioner = new SpacePartitioner(contourPlanes);
-                            partitioner->partition();
 
-                            delete projection;
-                            projection = new Projection(*partitioner);
+                        bool samePlanes = !g_rebuildJob && newContours.size() == contourPlanes.size();
+                        std::vector<size_t> changed;
+                        for (size_t i = 0; samePlanes && i < newContours.size(); i++) {
+                            if (newContours[i].plane != contourPlanes[i].plane) {
+                                samePlanes = false;
+                            } else if (!(newContours[i] == contourPlanes[i])) {
+                                changed.push_back(i);
+                            }
+                        }
 
-                            lastKeyPressTime = currentTime;
+                        if (samePlanes) {
+                            for (size_t i : changed) {
+                                partitioner->updateContour(i, newContours[i]);
+                            }
+                            size_t cells = projection->updateContours(*partitioner, changed);
+                            contourPlanes = std::move(newContours);
+                            std::cout << "Reloaded " << fs.getCurrentFileName() << ": " << changed.size()
+                                      << " contours changed, " << cells << " cells re-projected" << std::endl;
+                        } else {
+                            g_rebuildRequested = true;
+                        }
+                        lastKeyPressTime = currentTime;
+                    }
 
-                            std::cout << "Switched to: " << fs.getCurrentFileName()
-                                    << " (File " << fs.getCurrentIndex() + 1
-                                    << "/" << fs.getFileCount() << ")" << std::endl;
+                    if (fileChanged || g_rebuildRequested) {
+                        g_rebuildRequested = false;
+                        std::vector<ContourPlane> newContours = fs.getCurrentContours();
+                        if (!newContours.empty()) {
+                            // A newer request supersedes the running rebuild
+                            if (g_rebuildJob) {
+                                g_rebuildJob->token.cancel();
+                                g_cancelledJobs.push_back(std::move(g_rebuildJob));
+                            }
+                            g_rebuildJob = startRebuild(std::move(newContours), fs.getCurrentFileName());
+                            lastKeyPressTime = currentTime;
                         }
                     }
                 }
@@ -199,6 +302,31 @@ int main() {
                 }
             }
 
+            // Show a finished rebuild
+            auto isReady = [](const std::unique_ptr<RebuildJob>& job) {
+                return job->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            };
+            if (g_rebuildJob && isReady(g_rebuildJob)) {
+                try {
+                    RebuildResult result = g_rebuildJob->result.get();
+                    contourPlanes = std::move(result.contours);
+                    delete partitioner;
+                    partitioner = result.partitioner.release();
+                    delete projection;
+                    projection = result.projection.release();
+
+                    std::cout << "Switched to: " << g_rebuildJob->fileName
+                            << " (File " << fs.getCurrentIndex() + 1
+                            << "/" << fs.getFileCount() << ")" << std::endl;
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "File switching error: " << e.what() << std::endl;
+                }
+                g_rebuildJob.reset();
+            }
+            g_cancelledJobs.erase(std::remove_if(g_cancelledJobs.begin(), g_cancelledJobs.end(), isReady),
+                                  g_cancelledJobs.end());
+
             // Update viewport and camera
             int width, height;
             glfwGetFramebufferSize(window, &width, &height);
@@ -240,7 +368,15 @@ int main() {
             glfwPollEvents();
         }
 
-        // Cleanup
+        // Cleanup, waiting for running rebuilds to stop
+        if (g_rebuildJob) {
+            g_rebuildJob->token.cancel();
+            g_cancelledJobs.push_back(std::move(g_rebuildJob));
+        }
+        for (auto& job : g_cancelledJobs) {
+            job->token.cancel();
+        }
+        g_cancelledJobs.clear();
         delete partitioner;
         delete projection;
         glfwDestroyWindow(window);
@@ -1,16 +1,402 @@
 // partition.cpp
 #include "partition.h"
+#include "sign_matrix.h"
 #include <CGAL/bounding_box.h>
 #include <CGAL/convex_hull_3.h>
 #include <CGAL/Cartesian_converter.h>
+#include <CGAL/Interval_nt.h>
+#include <CGAL/FPU.h>
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
-#include <CGAL/IO/Polyhedron_OFF_iostream.h>
 #include <filesystem>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 namespace fs = std::filesystem;
 
+// Converter between kernels
+typedef CGAL::Cartesian_converter<InexactKernel, ExactKernel> IK_to_EK;
+
+namespace {
+
+// Memory field of /proc/self/status in KiB, 0 where it is not available
+size_t readStatusKb(const std::string& field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, field.size() + 1, field + ":") == 0) {
+            return std::stoul(line.substr(field.size() + 1));
+        }
+    }
+    return 0;
+}
+
+// Restart the VmHWM high-water mark, so the peak covers one partition only.
+// Best effort, older kernels ignore the request.
+void resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+// Compact double precision copy of an exact convex polyhedron
+SpacePartitioner::ConvexCell makeConvexCell(const ExactPolyhedron& poly) {
+    SpacePartitioner::ConvexCell cell;
+    std::unordered_map<const ExactPolyhedron::Vertex*, size_t> vertexIndex;
+    for (auto v = poly.vertices_begin(); v != poly.vertices_end(); ++v) {
+        vertexIndex[&*v] = cell.vertices.size();
+        cell.vertices.emplace_back(CGAL::to_double(v->point().x()),
+                                   CGAL::to_double(v->point().y()),
+                                   CGAL::to_double(v->point().z()));
+    }
+
+    cell.faces.reserve(poly.size_of_facets());
+    for (auto f = poly.facets_begin(); f != poly.facets_end(); ++f) {
+        std::vector<size_t> face;
+        auto h = f->facet_begin();
+        do {
+            face.push_back(vertexIndex[&*h->vertex()]);
+        } while (++h != f->facet_begin());
+        cell.faces.push_back(std::move(face));
+    }
+
+    cell.bbox = CGAL::bbox_3(cell.vertices.begin(), cell.vertices.end());
+    return cell;
+}
+
+void writeCellOff(std::ostream& out, const SpacePartitioner::ConvexCell& cell) {
+    out << "OFF\n" << cell.vertices.size() << " " << cell.faces.size() << " 0\n\n";
+    out << std::setprecision(17);
+    for (const auto& p : cell.vertices) {
+        out << p.x() << " " << p.y() << " " << p.z() << "\n";
+    }
+    for (const auto& face : cell.faces) {
+        out << face.size();
+        for (size_t idx : face) {
+            out << " " << idx;
+        }
+        out << "\n";
+    }
+}
+
+bool readCellOff(std::istream& in, SpacePartitioner::ConvexCell& cell) {
+    std::string header;
+    if (!(in >> header) || header != "OFF") {
+        return false;
+    }
+
+    // Files written by CGAL may carry comment lines after the header
+    std::string comment;
+    while ((in >> std::ws).peek() == '#') {
+        std::getline(in, comment);
+    }
+
+    size_t vertexCount, faceCount, edgeCount;
+    if (!(in >> vertexCount >> faceCount >> edgeCount)) {
+        return false;
+    }
+
+    cell.vertices.clear();
+    cell.faces.clear();
+    for (size_t i = 0; i < vertexCount && in; ++i) {
+        double x, y, z;
+        in >> x >> y >> z;
+        cell.vertices.emplace_back(x, y, z);
+    }
+    for (size_t i = 0; i < faceCount && in; ++i) {
+        size_t size;
+        in >> size;
+        std::vector<size_t> face(size);
+        for (auto& idx : face) {
+            in >> idx;
+            if (idx >= vertexCount) return false;
+        }
+        cell.faces.push_back(std::move(face));
+    }
+
+    cell.bbox = CGAL::bbox_3(cell.vertices.begin(), cell.vertices.end());
+    return static_cast<bool>(in);
+}
+
+// Point inside the cell, up to 'tolerance' outside of its faces
+bool cellContains(const std::vector<Plane>& faces, const Point& p, double tolerance) {
+    for (const auto& face : faces) {
+        if (face.a() * p.x() + face.b() * p.y() + face.c() * p.z() + face.d() > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Planes with unit normals, in the layout of the sign kernel
+PlanesSoA toUnitPlanes(const std::vector<Plane>& input) {
+    PlanesSoA planes;
+    planes.reserve(input.size());
+    for (const auto& plane : input) {
+        double norm = std::sqrt(plane.orthogonal_vector().squared_length());
+        planes.push_back(plane.a() / norm, plane.b() / norm, plane.c() / norm, plane.d() / norm);
+    }
+    return planes;
+}
+
+// Largest distance of the points from the plane
+double maxPlaneDistance(const Plane& plane, const std::vector<Point>& points) {
+    double norm = std::sqrt(plane.orthogonal_vector().squared_length());
+    double distance = 0.0;
+    for (const auto& p : points) {
+        double d = plane.a() * p.x() + plane.b() * p.y() + plane.c() * p.z() + plane.d();
+        distance = std::max(distance, std::abs(d) / norm);
+    }
+    return distance;
+}
+
+// Unit normals within 'tolerance' of each other (in either orientation)
+// and offsets within 'tolerance' relative to the bounding box diagonal
+bool nearlyCoplanar(const Plane& a, const Plane& b, double tolerance, double diagonal) {
+    Vector na = a.orthogonal_vector();
+    Vector nb = b.orthogonal_vector();
+    double la = std::sqrt(na.squared_length());
+    double lb = std::sqrt(nb.squared_length());
+    double s = (na * nb < 0.0) ? -1.0 : 1.0;
+    Vector dn = na / la - s * (nb / lb);
+    return std::sqrt(dn.squared_length()) <= tolerance &&
+           std::abs(a.d() / la - s * b.d() / lb) <= tolerance * diagonal;
+}
+
+// Bits of the integer normal of a snapped plane
+const int kSnappedNormalBits = 16;
+
+// Rational with a 64-bit numerator and a positive 64-bit denominator
+struct SmallRational {
+    int64_t num = 0;
+    int64_t den = 1;
+};
+
+// Standard (finite) coordinate whose numerator and denominator fit in 62 bits
+bool toSmallRational(const ExactKernel::RT& value, SmallRational& out) {
+    if (value.degree() != 0) return false;
+    mpq_srcptr q = value[0].mpq();
+    if (mpz_sizeinbase(mpq_numref(q), 2) > 62 || mpz_sizeinbase(mpq_denref(q), 2) > 62) {
+        return false;
+    }
+    out.num = mpz_get_si(mpq_numref(q));
+    out.den = mpz_get_si(mpq_denref(q));
+    return true;
+}
+
+unsigned __int128 gcd128(unsigned __int128 a, unsigned __int128 b) {
+    while (b != 0) {
+        unsigned __int128 r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// Exact sign of a*x + b*y + c*z + d over the common denominator of the
+// terms, false when an intermediate value does not fit in 128 bits
+bool integerSide(const SmallRational (&plane)[4], const SmallRational (&point)[3], int& sign) {
+    __int128 termNum[4], termDen[4];
+    for (int i = 0; i < 3; ++i) {
+        termNum[i] = static_cast<__int128>(plane[i].num) * point[i].num;
+        termDen[i] = static_cast<__int128>(plane[i].den) * point[i].den;
+    }
+    termNum[3] = plane[3].num;
+    termDen[3] = plane[3].den;
+
+    __int128 common = 1;
+    for (int i = 0; i < 4; ++i) {
+        __int128 factor = termDen[i] / static_cast<__int128>(gcd128(common, termDen[i]));
+        if (__builtin_mul_overflow(common, factor, &common)) return false;
+    }
+
+    __int128 sum = 0;
+    for (int i = 0; i < 4; ++i) {
+        __int128 term;
+        if (__builtin_mul_overflow(termNum[i], common / termDen[i], &term) ||
+            __builtin_add_overflow(sum, term, &sum)) {
+            return false;
+        }
+    }
+    sign = (sum > 0) - (sum < 0);
+    return true;
+}
+
+// Plane with interval copies of its coefficients: orientation tests are
+// decided in interval arithmetic and only fall back to exact arithmetic
+// when the interval contains zero. With 'integerPredicates' set the exact
+// test is first tried in 128-bit integers, which is enough for the small
+// rationals of a grid snapped partition, and GMP is the last resort.
+class FilteredPlane {
+public:
+    explicit FilteredPlane(const ExactKernel::Plane_3& plane, size_t* integerPredicates = nullptr)
+        : m_plane(plane),
+          m_a(CGAL::to_interval(plane.a())),
+          m_b(CGAL::to_interval(plane.b())),
+          m_c(CGAL::to_interval(plane.c())),
+          m_d(CGAL::to_interval(plane.d())),
+          m_integerPredicates(integerPredicates) {
+        m_hasSmallPlane = integerPredicates &&
+                          toSmallRational(plane.a(), m_small[0]) &&
+                          toSmallRational(plane.b(), m_small[1]) &&
+                          toSmallRational(plane.c(), m_small[2]) &&
+                          toSmallRational(plane.d(), m_small[3]);
+    }
+
+    CGAL::Oriented_side side(const ExactPoint& p, size_t& exactPredicates) const {
+        {
+            CGAL::Protect_FPU_rounding<true> protector;
+            Interval value = m_a * Interval(CGAL::to_interval(p.x()))
+                           + m_b * Interval(CGAL::to_interval(p.y()))
+                           + m_c * Interval(CGAL::to_interval(p.z()))
+                           + m_d;
+            if (value.inf() > 0) return CGAL::ON_POSITIVE_SIDE;
+            if (value.sup() < 0) return CGAL::ON_NEGATIVE_SIDE;
+        }
+        exactPredicates++;
+
+        SmallRational point[3];
+        int sign;
+        if (m_hasSmallPlane &&
+            toSmallRational(p.x(), point[0]) &&
+            toSmallRational(p.y(), point[1]) &&
+            toSmallRational(p.z(), point[2]) &&
+            integerSide(m_small, point, sign)) {
+            (*m_integerPredicates)++;
+            return sign > 0 ? CGAL::ON_POSITIVE_SIDE
+                 : sign < 0 ? CGAL::ON_NEGATIVE_SIDE
+                 : CGAL::ON_ORIENTED_BOUNDARY;
+        }
+        return m_plane.oriented_side(p);
+    }
+
+private:
+    typedef CGAL::Interval_nt<> Interval;
+    const ExactKernel::Plane_3& m_plane;
+    Interval m_a, m_b, m_c, m_d;
+    size_t* m_integerPredicates;
+    bool m_hasSmallPlane = false;
+    SmallRational m_small[4];
+};
+
+// Some edge of the contour keeps a piece longer than 'tolerance' after
+// clipping to the cell
+bool contourCrossesCell(const ContourPlane& contour, const CGAL::Bbox_3& contourBox,
+                        const CGAL::Bbox_3& cellBox, const std::vector<Plane>& faces,
+                        double tolerance) {
+    if (contour.vertices.empty() || !CGAL::do_overlap(cellBox, contourBox)) {
+        return false;
+    }
+    for (const auto& edge : contour.edges) {
+        const Point& a = contour.vertices[edge.first];
+        const Point& b = contour.vertices[edge.second];
+        double t0, t1;
+        if (clipSegmentToConvex(faces, a, b, tolerance, t0, t1) &&
+            (t1 - t0) * std::sqrt(CGAL::squared_distance(a, b)) > tolerance) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Tree read from a file is a proper binary tree over 'cellCount' cells and
+// 'planeCount' splitters: inner nodes have two children linking back to
+// them, leaves have none, and every node is reached from the root
+bool isValidTree(const std::vector<SpacePartitioner::BSPNode>& tree, size_t cellCount, size_t planeCount) {
+    int32_t size = static_cast<int32_t>(tree.size());
+    if (tree.empty() || tree[0].parent != -1) return false;
+
+    for (int32_t n = 0; n < size; ++n) {
+        const auto& node = tree[n];
+        if (node.splitter < -1 || node.splitter >= static_cast<int32_t>(planeCount)) return false;
+        if (node.splitter >= 0) {
+            for (int32_t child : {node.below, node.above}) {
+                if (child <= 0 || child >= size || tree[child].parent != n) return false;
+            }
+            if (node.below == node.above || node.cell != -1) return false;
+        } else if (node.below != -1 || node.above != -1 ||
+                   node.cell < -1 || node.cell >= static_cast<int32_t>(cellCount)) {
+            return false;
+        }
+        if (n > 0 && (node.parent < 0 || node.parent >= size)) return false;
+    }
+
+    // Children link back to their parent, so a walk from the root visits
+    // every node at most once; the rest would hang off a cycle
+    size_t reached = 0;
+    std::vector<int32_t> pending = {0};
+    while (!pending.empty()) {
+        const auto& node = tree[pending.back()];
+        pending.pop_back();
+        if (++reached > tree.size()) return false;
+        if (node.splitter >= 0) {
+            pending.push_back(node.below);
+            pending.push_back(node.above);
+        }
+    }
+    return reached == tree.size();
+}
+
+// 64-bit FNV-1a hash, fed field by field
+class Fnv1a {
+public:
+    void mix(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            m_hash = (m_hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+    void mixDouble(double value) { mix(&value, sizeof(value)); }
+    void mixSize(size_t value) {
+        uint64_t v = value;
+        mix(&v, sizeof(v));
+    }
+    void mixPlane(const Plane& plane) {
+        mixDouble(plane.a());
+        mixDouble(plane.b());
+        mixDouble(plane.c());
+        mixDouble(plane.d());
+    }
+    void mixPoint(const Point& p) {
+        mixDouble(p.x());
+        mixDouble(p.y());
+        mixDouble(p.z());
+    }
+    uint64_t value() const { return m_hash; }
+
+private:
+    uint64_t m_hash = 1469598103934665603ull;
+};
+
+} // namespace
+
 std::string SpacePartitioner::getConvexCellsPath(const std::string& contourName) const {
-    return "../data/convex_cells/" + contourName;
+    std::string path = "../data/convex_cells/" + contourName;
+    if (m_footprintLocalized) {
+        // Localized cuts depend on the order the planes are applied in
+        path += "_footprint";
+        if (m_planeOrdering == PlaneOrdering::MostBalanced) path += "_balanced";
+        if (m_planeOrdering == PlaneOrdering::FewestCrossings) path += "_crossings";
+        if (m_footprintInflation > 0.0) {
+            std::ostringstream inflation;
+            inflation << "_inflate" << m_footprintInflation;
+            path += inflation.str();
+        }
+    }
+    if (m_integerSnapping) {
+        std::ostringstream spacing;
+        spacing << "_snapped" << m_gridSpacing;
+        path += spacing.str();
+    }
+    return path;
 }
 
 void SpacePartitioner::ensureDirectoryExists(const std::string& path) const {
@@ -18,41 +404,66 @@ void SpacePartitioner::ensureDirectoryExists(const std::string& path) const {
 }
 
 bool SpacePartitioner::loadConvexCells(const std::string& contourName) {
+    if (!m_cacheEnabled) return false;
+
     std::string cellsDir = getConvexCellsPath(contourName);
     if (!fs::exists(cellsDir)) return false;
 
+    // Cells partitioned on other planes are stale, as are caches written
+    // before the fingerprint was stored
+    std::ifstream fingerprintFile(cellsDir + "/cells.fingerprint");
+    uint64_t fingerprint;
+    if (!(fingerprintFile >> fingerprint) || fingerprint != computeCacheFingerprint()) {
+        std::cout << "Cached partition of " << contourName << " does not match the planes, ignoring it"
+                  << std::endl;
+        return false;
+    }
+
     m_cells.clear();
-    size_t cellCount = 0;
-
-    for (const auto& entry : fs::directory_iterator(cellsDir)) {
-        if (entry.path().extension() == ".off") {
-            ConvexCell cell;
-            
-            // Load geometry
-            std::ifstream geomFile(entry.path());
-            if (!geomFile || !CGAL::read_off(geomFile, cell.geometry)) {
-                return false;
-            }
 
-            // Load plane associations
-            std::string planesPath = entry.path().string();
-            planesPath.replace(planesPath.end()-4, planesPath.end(), ".planes");
-            std::ifstream planesFile(planesPath);
-            size_t planeIdx;
-            while (planesFile >> planeIdx) {
-                cell.planeIndices.push_back(planeIdx);
-            }
+    // Cells are read in index order, the tree refers to them by index
+    for (size_t i = 0; ; ++i) {
+        std::string cellBase = cellsDir + "/cell_" + std::to_string(i);
+        if (!fs::exists(cellBase + ".off")) break;
 
-            m_cells.push_back(cell);
-            cellCount++;
+        ConvexCell cell;
+
+        // Load geometry
+        std::ifstream geomFile(cellBase + ".off");
+        if (!geomFile || !readCellOff(geomFile, cell)) {
+            return false;
+        }
+
+        // Load plane associations
+        std::ifstream planesFile(cellBase + ".planes");
+        size_t planeIdx;
+        while (planesFile >> planeIdx) {
+            cell.planeIndices.push_back(planeIdx);
         }
+
+        m_cells.push_back(cell);
     }
 
-    return cellCount > 0;
+    // Caches written before the tree was stored fall back to linear scans
+    if (!loadTree(cellsDir + "/bsp.tree")) {
+        m_tree.clear();
+        m_splitPlanes.clear();
+        m_splitContours.clear();
+    }
+
+    if (!loadAdjacency(cellsDir + "/adjacency.graph")) {
+        buildAdjacency();
+    }
+
+    // Incidence is derived from the cell geometry, so caches written with
+    // stale plane associations are corrected on load
+    computeIncidence();
+
+    return !m_cells.empty();
 }
 
 void SpacePartitioner::saveConvexCells(const std::string& contourName) const {
-    if (m_cells.empty()) return;
+    if (!m_cacheEnabled || m_cells.empty()) return;
 
     std::string cellsDir = getConvexCellsPath(contourName);
     ensureDirectoryExists(cellsDir);
@@ -62,7 +473,7 @@ void SpacePartitioner::saveConvexCells(const std::string& contourName) const {
         std::string offFile = cellsDir + "/cell_" + std::to_string(i) + ".off";
         std::ofstream geomFile(offFile);
         if (geomFile) {
-            CGAL::write_off(geomFile, m_cells[i].geometry);
+            writeCellOff(geomFile, m_cells[i]);
         }
 
         // Save plane associations
@@ -74,14 +485,439 @@ void SpacePartitioner::saveConvexCells(const std::string& contourName) const {
             }
         }
     }
+
+    // Drop cells left over from a larger partition
+    for (size_t i = m_cells.size(); ; ++i) {
+        std::string cellBase = cellsDir + "/cell_" + std::to_string(i);
+        if (!fs::exists(cellBase + ".off")) break;
+        fs::remove(cellBase + ".off");
+        fs::remove(cellBase + ".planes");
+    }
+
+    saveTree(cellsDir + "/bsp.tree");
+    saveAdjacency(cellsDir + "/adjacency.graph");
+
+    // Written last, so an interrupted save is not taken for a complete one
+    std::ofstream fingerprintFile(cellsDir + "/cells.fingerprint");
+    if (fingerprintFile) {
+        fingerprintFile << computeCacheFingerprint() << "\n";
+    }
+}
+
+void SpacePartitioner::saveTree(const std::string& path) const {
+    if (m_tree.empty()) return;
+
+    std::ofstream file(path);
+    if (!file) return;
+
+    file << std::setprecision(17);
+    file << "BSP 3\n";
+    const auto& [min_corner, max_corner] = m_treeBounds;
+    file << min_corner.x() << " " << min_corner.y() << " " << min_corner.z() << " "
+         << max_corner.x() << " " << max_corner.y() << " " << max_corner.z() << "\n";
+
+    file << m_splitPlanes.size() << "\n";
+    for (size_t i = 0; i < m_splitPlanes.size(); ++i) {
+        const Plane& plane = m_splitPlanes[i];
+        file << plane.a() << " " << plane.b() << " " << plane.c() << " " << plane.d() << " "
+             << m_planeSources[i].size();
+        // All coplanar contours behind the splitter, the representative first
+        for (size_t source : m_planeSources[i]) {
+            file << " " << source;
+        }
+        file << "\n";
+    }
+
+    file << m_tree.size() << "\n";
+    for (const auto& node : m_tree) {
+        file << node.splitter << " " << node.below << " " << node.above << " "
+             << node.cell << " " << node.parent << "\n";
+    }
 }
 
-// Converter between kernels
-typedef CGAL::Cartesian_converter<InexactKernel, ExactKernel> IK_to_EK;
-typedef CGAL::Cartesian_converter<ExactKernel, InexactKernel> EK_to_IK;
+bool SpacePartitioner::loadTree(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string magic;
+    int version;
+    if (!(file >> magic >> version) || magic != "BSP" || version != 3) return false;
+
+    double x0, y0, z0, x1, y1, z1;
+    file >> x0 >> y0 >> z0 >> x1 >> y1 >> z1;
+    m_treeBounds = std::make_pair(Point(x0, y0, z0), Point(x1, y1, z1));
+
+    size_t planeCount;
+    file >> planeCount;
+    m_splitPlanes.clear();
+    m_splitContours.clear();
+    m_planeSources.clear();
+    m_exactPlanes.clear();
+    for (size_t i = 0; i < planeCount && file; ++i) {
+        double a, b, c, d;
+        size_t sourceCount;
+        file >> a >> b >> c >> d >> sourceCount;
+        std::vector<size_t> sources(sourceCount);
+        for (auto& source : sources) {
+            file >> source;
+        }
+        if (!file || sources.empty()) return false;
+        for (size_t source : sources) {
+            if (source >= m_contourPlanes.size()) return false;
+        }
+        m_splitPlanes.emplace_back(a, b, c, d);
+        m_splitContours.push_back(sources.front());
+        m_planeSources.push_back(std::move(sources));
+    }
+
+    size_t nodeCount;
+    file >> nodeCount;
+    m_tree.assign(nodeCount, BSPNode());
+    for (auto& node : m_tree) {
+        file >> node.splitter >> node.below >> node.above >> node.cell >> node.parent;
+    }
+
+    // Reject truncated trees and trees that do not match the cells next to them
+    return file && isValidTree(m_tree, m_cells.size(), m_splitPlanes.size());
+}
+
+uint64_t SpacePartitioner::computeFingerprint() const {
+    // FNV-1a over everything the traversal depends on
+    Fnv1a hash;
+    for (size_t i = 0; i < m_splitPlanes.size(); ++i) {
+        hash.mixPlane(m_splitPlanes[i]);
+        for (size_t source : m_planeSources[i]) {
+            hash.mixSize(source);
+        }
+    }
+    hash.mixPoint(m_treeBounds.first);
+    hash.mixPoint(m_treeBounds.second);
+
+    // Footprints are built from the contour vertices
+    hash.mixSize(m_footprintLocalized);
+    if (m_footprintLocalized) {
+        hash.mixDouble(m_footprintInflation);
+        for (const auto& contourPlane : m_contourPlanes) {
+            for (const auto& v : contourPlane.vertices) {
+                hash.mixPoint(v);
+            }
+        }
+    }
+    return hash.value();
+}
+
+uint64_t SpacePartitioner::computeCacheFingerprint() const {
+    // The cache directory is named after the contour file and the settings,
+    // so edited planes would otherwise load the cells of the old ones
+    Fnv1a hash;
+    hash.mixSize(m_partitionPlanes.size());
+    for (const auto& plane : m_partitionPlanes) {
+        hash.mixPlane(plane);
+    }
+    auto [min_corner, max_corner] = getBBoxCorners();
+    hash.mixPoint(min_corner);
+    hash.mixPoint(max_corner);
+    hash.mixDouble(m_coplanarTolerance);
+    hash.mixSize(static_cast<size_t>(m_planeOrdering));
+
+    if (m_footprintLocalized) {
+        for (const auto& contourPlane : m_contourPlanes) {
+            for (const auto& v : contourPlane.vertices) {
+                hash.mixPoint(v);
+            }
+        }
+    }
+    return hash.value();
+}
+
+void SpacePartitioner::writeCheckpoint(const std::vector<PartitionNode>& stack,
+                                       double finishedWeight) const {
+    // Written next to the checkpoint and renamed over it, so a kill while
+    // writing leaves the previous checkpoint intact. A cancelled job may
+    // still be writing while a new one runs on the same cache, so every
+    // writer has its own temporary file.
+    std::ostringstream tmpName;
+    tmpName << m_checkpointPath << ".tmp." << ::getpid() << "."
+            << std::hash<std::thread::id>()(std::this_thread::get_id());
+    std::string tmpPath = tmpName.str();
+    {
+        std::ofstream file(tmpPath);
+        if (!file) return;
+
+        file << std::setprecision(17);
+        file << "CKPT 1\n" << std::hex << m_checkpointFingerprint << std::dec << "\n";
+        file << finishedWeight << " " << m_stats.exactSplits << " " << m_stats.skippedSplits << " "
+             << m_stats.exactPredicates << " " << m_stats.footprintSkips << " "
+             << m_stats.integerPredicates << "\n";
+
+        file << m_tree.size() << "\n";
+        for (const auto& node : m_tree) {
+            file << node.splitter << " " << node.below << " " << node.above << " "
+                 << node.cell << " " << node.parent << "\n";
+        }
+
+        file << m_cells.size() << "\n";
+        for (const auto& cell : m_cells) {
+            writeCellOff(file, cell);
+            file << cell.planeIndices.size();
+            for (size_t idx : cell.planeIndices) {
+                file << " " << idx;
+            }
+            file << "\n";
+        }
+
+        // Pending nodes only need their tree node, the region is rebuilt
+        // from the tree path on resume
+        file << stack.size() << "\n";
+        for (const auto& node : stack) {
+            file << node.treeNode << " " << node.planeIndex << " " << node.weight << " "
+                 << node.planes.size();
+            for (size_t idx : node.planes) {
+                file << " " << idx;
+            }
+            file << "\n";
+        }
+
+        file.flush();
+        if (!file) {
+            file.close();
+            std::error_code error;
+            fs::remove(tmpPath, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(tmpPath, m_checkpointPath, error);
+    if (error) {
+        std::cerr << "Could not write checkpoint " << m_checkpointPath << ": "
+                  << error.message() << std::endl;
+        fs::remove(tmpPath, error);
+    }
+}
+
+bool SpacePartitioner::loadCheckpoint(std::vector<PartitionNode>& stack, double& finishedWeight) {
+    std::ifstream file(m_checkpointPath);
+    if (!file) return false;
+
+    std::string magic;
+    int version;
+    uint64_t fingerprint;
+    if (!(file >> magic >> version) || magic != "CKPT" || version != 1) return false;
+    if (!(file >> std::hex >> fingerprint >> std::dec) || fingerprint != m_checkpointFingerprint) {
+        std::cout << "Ignoring checkpoint of a different partition setup" << std::endl;
+        return false;
+    }
+
+    PartitionStats stats = m_stats;
+    file >> finishedWeight >> stats.exactSplits >> stats.skippedSplits >> stats.exactPredicates
+         >> stats.footprintSkips >> stats.integerPredicates;
+
+    size_t nodeCount;
+    file >> nodeCount;
+    std::vector<BSPNode> tree(nodeCount);
+    for (auto& node : tree) {
+        file >> node.splitter >> node.below >> node.above >> node.cell >> node.parent;
+    }
+
+    size_t cellCount;
+    file >> cellCount;
+    std::vector<ConvexCell> cells(cellCount);
+    for (auto& cell : cells) {
+        size_t planeCount;
+        if (!readCellOff(file, cell) || !(file >> planeCount)) return false;
+        cell.planeIndices.resize(planeCount);
+        for (auto& idx : cell.planeIndices) {
+            file >> idx;
+        }
+    }
+
+    size_t pendingCount;
+    file >> pendingCount;
+    std::vector<PartitionNode> pending(pendingCount);
+    for (auto& node : pending) {
+        size_t planeCount;
+        file >> node.treeNode >> node.planeIndex >> node.weight >> planeCount;
+        for (size_t i = 0; i < planeCount && file; ++i) {
+            size_t idx;
+            file >> idx;
+            node.planes.insert(idx);
+        }
+        node.isDeferred = true;
+    }
+    if (!file || !isValidTree(tree, cells.size(), m_splitPlanes.size())) return false;
+    for (const auto& node : pending) {
+        if (node.treeNode < 0 || node.treeNode >= static_cast<int32_t>(tree.size())) return false;
+    }
+
+    m_tree = std::move(tree);
+    m_cells = std::move(cells);
+    m_stats = stats;
+    stack = std::move(pending);
+    return true;
+}
+
+void SpacePartitioner::saveAdjacency(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) return;
+
+    file << std::setprecision(17);
+    file << "ADJ 1\n" << m_adjacency.size() << "\n";
+    for (const auto& edge : m_adjacency) {
+        file << edge.cellBelow << " " << edge.cellAbove << " " << edge.planeIndex << " "
+             << edge.area << " " << edge.face.size();
+        for (const auto& p : edge.face) {
+            file << " " << p.x() << " " << p.y() << " " << p.z();
+        }
+        file << "\n";
+    }
+}
+
+bool SpacePartitioner::loadAdjacency(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string magic;
+    int version;
+    size_t edgeCount;
+    if (!(file >> magic >> version >> edgeCount) || magic != "ADJ" || version != 1) return false;
+
+    m_adjacency.assign(edgeCount, CellAdjacency());
+    for (auto& edge : m_adjacency) {
+        size_t faceSize;
+        file >> edge.cellBelow >> edge.cellAbove >> edge.planeIndex >> edge.area >> faceSize;
+        for (size_t i = 0; i < faceSize && file; ++i) {
+            double x, y, z;
+            file >> x >> y >> z;
+            edge.face.emplace_back(x, y, z);
+        }
+        if (!file || edge.cellBelow >= m_cells.size() || edge.cellAbove >= m_cells.size()) {
+            m_adjacency.clear();
+            return false;
+        }
+    }
+
+    indexAdjacency();
+    return true;
+}
+
+void SpacePartitioner::buildAdjacency() {
+    m_adjacency.clear();
+    std::vector<size_t> cells(m_cells.size());
+    std::iota(cells.begin(), cells.end(), 0);
+    linkCells(cells, std::vector<bool>(m_cells.size(), true));
+    indexAdjacency();
+}
+
+void SpacePartitioner::linkCells(const std::vector<size_t>& cells, const std::vector<bool>& isNew) {
+    if (m_splitPlanes.empty() || cells.empty()) return;
+
+    Point lo = m_treeBounds.first, hi = m_treeBounds.second;
+    double tolerance = 1e-9 * std::sqrt(CGAL::squared_distance(lo, hi));
+
+    // Neighbours across a splitting plane both have a face on that plane,
+    // so each plane only pairs the cells touching it from either side
+    for (size_t k = 0; k < m_splitPlanes.size(); ++k) {
+        m_progress.checkCancelled();
+        const Plane& plane = m_splitPlanes[k];
+        PlaneFrame frame = PlaneFrame::fromPlane(plane);
+        double norm = std::sqrt(plane.orthogonal_vector().squared_length());
+
+        struct PlaneFace {
+            size_t cell;
+            std::vector<Point2> polygon;
+        };
+        std::vector<PlaneFace> below, above;
+
+        for (size_t i : cells) {
+            std::vector<Point2> onPlane;
+            double farthest = 0.0;
+            for (const auto& p : m_cells[i].vertices) {
+                double d = (plane.a() * p.x() + plane.b() * p.y() + plane.c() * p.z() + plane.d()) / norm;
+                if (std::abs(d) <= tolerance) {
+                    onPlane.push_back(frame.to2d(p));
+                } else if (std::abs(d) > std::abs(farthest)) {
+                    farthest = d;
+                }
+            }
+            if (onPlane.size() < 3 || farthest == 0.0) continue;
+
+            PlaneFace face{i, convexHull2D(onPlane)};
+            if (face.polygon.size() < 3) continue;
+            (farthest < 0.0 ? below : above).push_back(std::move(face));
+        }
+
+        for (const auto& lower : below) {
+            for (const auto& upper : above) {
+                // Pairs of old cells are linked already
+                if (!isNew[lower.cell] && !isNew[upper.cell]) continue;
+
+                std::vector<Point2> shared = intersectConvexPolygons(lower.polygon, upper.polygon);
+                if (shared.size() < 3) continue;
+
+                double area = polygonArea(shared);
+                if (area <= tolerance * tolerance) continue;
+
+                CellAdjacency edge;
+                edge.cellBelow = lower.cell;
+                edge.cellAbove = upper.cell;
+                edge.planeIndex = m_splitContours[k];
+                edge.area = area;
+                for (const auto& p : shared) {
+                    edge.face.push_back(frame.to3d(p));
+                }
+                m_adjacency.push_back(std::move(edge));
+            }
+        }
+    }
+}
+
+void SpacePartitioner::indexAdjacency() {
+    m_cellAdjacency.assign(m_cells.size(), {});
+    for (size_t e = 0; e < m_adjacency.size(); ++e) {
+        m_cellAdjacency[m_adjacency[e].cellBelow].push_back(e);
+        m_cellAdjacency[m_adjacency[e].cellAbove].push_back(e);
+    }
+}
+
+int SpacePartitioner::locateCell(const Point& p) const {
+    if (m_tree.empty()) {
+        // No tree available, test the cells one by one
+        for (size_t i = 0; i < m_cells.size(); ++i) {
+            if (cellContains(computeFacePlanes(m_cells[i]), p, 0.0)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    const auto& [min_corner, max_corner] = m_treeBounds;
+    if (p.x() < min_corner.x() || p.y() < min_corner.y() || p.z() < min_corner.z() ||
+        p.x() > max_corner.x() || p.y() > max_corner.y() || p.z() > max_corner.z()) {
+        return -1;
+    }
+
+    int32_t n = 0;
+    while (m_tree[n].splitter >= 0) {
+        const Plane& plane = m_splitPlanes[m_tree[n].splitter];
+        n = plane.oriented_side(p) == CGAL::ON_POSITIVE_SIDE ? m_tree[n].above : m_tree[n].below;
+    }
+    return m_tree[n].cell;
+}
+
+std::vector<int> SpacePartitioner::locateCells(const std::vector<Point>& points) const {
+    std::vector<int> cells;
+    cells.reserve(points.size());
+    for (const auto& p : points) {
+        cells.push_back(locateCell(p));
+    }
+    return cells;
+}
 
 SpacePartitioner::SpacePartitioner(const std::vector<ContourPlane>& contourPlanes)
-    : m_contourPlanes(contourPlanes) {}
+    : m_contourPlanes(contourPlanes) {
+    computePartitionPlanes();
+}
 
 std::pair<Point, Point> SpacePartitioner::getBBoxCorners() const {
     std::vector<Point> allPoints;
@@ -99,14 +935,73 @@ std::pair<Point, Point> SpacePartitioner::getBBoxCorners() const {
     double dz = bbox.zmax() - bbox.zmin();
     double padding = 0.05 * std::sqrt(dx*dx + dy*dy + dz*dz);
     
-    return std::make_pair(
-        Point(bbox.xmin() - padding, bbox.ymin() - padding, bbox.zmin() - padding),
-        Point(bbox.xmax() + padding, bbox.ymax() + padding, bbox.zmax() + padding)
-    );
+    Point lo(bbox.xmin() - padding, bbox.ymin() - padding, bbox.zmin() - padding);
+    Point hi(bbox.xmax() + padding, bbox.ymax() + padding, bbox.zmax() + padding);
+    if (m_integerSnapping) {
+        // Box faces on grid planes, rounded outwards
+        double h = m_gridSpacing;
+        lo = Point(std::floor(lo.x() / h) * h, std::floor(lo.y() / h) * h, std::floor(lo.z() / h) * h);
+        hi = Point(std::ceil(hi.x() / h) * h, std::ceil(hi.y() / h) * h, std::ceil(hi.z() / h) * h);
+    }
+    return std::make_pair(lo, hi);
 }
 
-Nef_polyhedron SpacePartitioner::computeBoundingBox() const {
+void SpacePartitioner::setIntegerSnapping(bool enabled, double spacing) {
+    m_integerSnapping = enabled;
+    // A power of two keeps the grid values exact in double
+    m_gridSpacing = std::exp2(std::round(std::log2(spacing)));
+    computePartitionPlanes();
+}
+
+Plane SpacePartitioner::snapPlane(const ContourPlane& contourPlane) const {
+    // Integer normal and an offset on the grid: every coefficient is a
+    // small dyadic rational, and so is every vertex of the partition. The
+    // offset is rounded after scaling by the normal, so the plane moves by
+    // at most h / (2 |normal|) along it.
+    Vector normal = contourPlane.plane.orthogonal_vector();
+    normal = normal / std::sqrt(normal.squared_length());
+    double scale = std::ldexp(1.0, kSnappedNormalBits);
+    Vector snapped(std::round(normal.x() * scale),
+                   std::round(normal.y() * scale),
+                   std::round(normal.z() * scale));
+
+    Vector centroid(0, 0, 0);
+    for (const auto& v : contourPlane.vertices) {
+        centroid = centroid + (v - CGAL::ORIGIN);
+    }
+    Point anchor = contourPlane.vertices.empty()
+        ? contourPlane.plane.point()
+        : CGAL::ORIGIN + centroid / static_cast<double>(contourPlane.vertices.size());
+
+    double h = m_gridSpacing;
+    double offset = std::round((snapped * (anchor - CGAL::ORIGIN)) / h) * h;
+    return Plane(snapped.x(), snapped.y(), snapped.z(), -offset);
+}
+
+void SpacePartitioner::computePartitionPlanes() {
+    m_partitionPlanes.clear();
+    m_snapError = 0.0;
+    for (const auto& contourPlane : m_contourPlanes) {
+        if (!m_integerSnapping) {
+            m_partitionPlanes.push_back(contourPlane.plane);
+            continue;
+        }
+
+        m_partitionPlanes.push_back(snapPlane(contourPlane));
+        m_snapError = std::max(m_snapError, maxPlaneDistance(m_partitionPlanes.back(),
+                                                             contourPlane.vertices));
+    }
+}
+
+double SpacePartitioner::contourTolerance() const {
+    // Contours are single precision input, and lie off their splitter by up
+    // to the snapping error
     auto [min_corner, max_corner] = getBBoxCorners();
+    return 1e-6 * std::sqrt(CGAL::squared_distance(min_corner, max_corner)) + m_snapError;
+}
+
+Nef_polyhedron SpacePartitioner::computeBoundingBox() const {
+    const auto& [min_corner, max_corner] = m_treeBounds;
     
     // Convert to exact kernel
     IK_to_EK to_exact;
@@ -136,96 +1031,1062 @@ Nef_polyhedron SpacePartitioner::computeBoundingBox() const {
     return Nef_polyhedron(exact_poly);
 }
 
-void SpacePartitioner::partition() {
+void SpacePartitioner::partition(const CancellationToken* token, ProgressCallback progress) {
+    // The reporter only lives for this call, also when it is cancelled
+    m_progress = ProgressReporter(token, std::move(progress));
+    try {
+        computePartition();
+    } catch (...) {
+        m_progress = ProgressReporter();
+        m_checkpointPath.clear();
+        throw;
+    }
+    m_progress = ProgressReporter();
+    m_checkpointPath.clear();
+}
+
+void SpacePartitioner::computePartition() {
     std::string contourName = fs::path(m_contourPlanes[0].filename).stem().string();
-    
+
     if (loadConvexCells(contourName)) {
+        m_progress.report(1.0);
         return;
     }
 
     std::cout << "Computing partition for " << contourName << "..." << std::endl;
+    m_stats = PartitionStats();
+    m_progress.setPhase(0.0, 0.05);
     precomputePlanes();
-    m_partitionedSpace = computeBoundingBox();
-    
-    std::vector<std::pair<Nef_polyhedron, std::set<size_t>>> nefPolys;
-    partitionSpace(m_partitionedSpace, 0, nefPolys);
+    if (m_footprintLocalized) {
+        precomputeFootprints();
+    }
+    m_treeBounds = getBBoxCorners();
+    resetPeakRss();
+    m_progress.setPhase(0.05, 0.85);
 
-    // Filter elementary cells
+    // Long traversals are checkpointed next to the cache and resumed from
+    // there after an interruption
+    if (m_cacheEnabled && m_checkpointInterval > 0.0) {
+        std::string cellsDir = getConvexCellsPath(contourName);
+        ensureDirectoryExists(cellsDir);
+        m_checkpointPath = cellsDir + "/partition.checkpoint";
+        m_checkpointFingerprint = computeFingerprint();
+        m_lastCheckpoint = std::chrono::steady_clock::now();
+    }
+
+    // The root Nef is handed over to the traversal, which drops every Nef
+    // as soon as its cells are extracted
     m_cells.clear();
-    for (const auto& [nef, planeSet] : nefPolys) {
-        bool isElementary = true;
-        CGAL::Polyhedron_3<ExactKernel> poly_i;
-        nef.convert_to_polyhedron(poly_i);
-        
-        for (const auto& [other_nef, other_set] : nefPolys) {
-            if (&nef != &other_nef) {
-                Nef_polyhedron intersection = nef * other_nef;
-                if (!intersection.is_empty()) {
-                    CGAL::Polyhedron_3<ExactKernel> poly_intersection;
-                    intersection.convert_to_polyhedron(poly_intersection);
-                    
-                    if (poly_intersection.size_of_vertices() == poly_i.size_of_vertices()) {
-                        isElementary = false;
-                        break;
-                    }
+    m_tree.assign(1, BSPNode());
+    std::vector<size_t> splitters(m_exactPlanes.size());
+    std::iota(splitters.begin(), splitters.end(), 0);
+
+    std::vector<PartitionNode> frontier;
+    double finishedWeight = 0.0;
+    if (!m_checkpointPath.empty() && loadCheckpoint(frontier, finishedWeight)) {
+        std::cout << "Resuming partition from checkpoint: " << m_cells.size() << " cells done, "
+                  << frontier.size() << " nodes pending" << std::endl;
+        traverseNodes(frontier, splitters, finishedWeight);
+    } else {
+        partitionSpace(computeBoundingBox(), 0, splitters, {});
+    }
+    m_progress.setPhase(0.85, 0.95);
+    filterElementaryCells();
+    m_progress.setPhase(0.95, 1.0);
+    buildAdjacency();
+    computeIncidence();
+
+    // Exact planes are rebuilt from m_splitPlanes when the tree is edited
+    m_stats.peakRssKb = readStatusKb("VmHWM");
+    m_exactPlanes.clear();
+    m_exactPlanes.shrink_to_fit();
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    m_stats.steadyRssKb = readStatusKb("VmRSS");
+
+    std::cout << "Partition used " << m_stats.exactSplits << " exact splits, skipped "
+              << m_stats.skippedSplits << " (" << m_stats.exactPredicates
+              << " vertex tests needed exact arithmetic)" << std::endl;
+    if (m_integerSnapping) {
+        std::cout << "Integer arithmetic settled " << m_stats.integerPredicates
+                  << " of the exact vertex tests" << std::endl;
+    }
+    if (m_stats.mergedPlanes > 0) {
+        std::cout << "Merged " << m_stats.mergedPlanes << " coplanar planes" << std::endl;
+    }
+    if (m_footprintLocalized) {
+        std::cout << "Footprint localization skipped " << m_stats.footprintSkips
+                  << " cuts" << std::endl;
+    }
+    if (m_stats.peakRssKb > 0) {
+        std::cout << "Peak RSS during partition " << m_stats.peakRssKb / 1024
+                  << " MiB, " << m_stats.steadyRssKb / 1024 << " MiB afterwards" << std::endl;
+    }
+
+    saveConvexCells(contourName);
+    if (!m_checkpointPath.empty()) {
+        std::error_code error;
+        fs::remove(m_checkpointPath, error);
+    }
+    m_progress.report(1.0);
+}
+
+void SpacePartitioner::precomputePlanes() {
+    IK_to_EK to_exact;
+    mergeCoplanarPlanes();
+    orderPlanes();
+
+    m_exactPlanes.clear();
+    m_splitPlanes.clear();
+    m_splitContours.clear();
+    m_exactPlanes.reserve(m_planeSources.size());
+    for (const auto& sources : m_planeSources) {
+        m_splitContours.push_back(sources.front());
+        m_splitPlanes.push_back(m_partitionPlanes[sources.front()]);
+        m_exactPlanes.push_back(to_exact(m_splitPlanes.back()));
+    }
+}
+
+void SpacePartitioner::mergeCoplanarPlanes() {
+    IK_to_EK to_exact;
+    size_t n = m_contourPlanes.size();
+
+    auto [min_corner, max_corner] = getBBoxCorners();
+    double diagonal = std::sqrt(CGAL::squared_distance(min_corner, max_corner));
+
+    m_planeSources.clear();
+    std::vector<ExactKernel::Plane_3> representatives;
+    for (size_t i = 0; i < n; ++i) {
+        ExactKernel::Plane_3 exact = to_exact(m_partitionPlanes[i]);
+
+        bool merged = false;
+        for (size_t k = 0; k < m_planeSources.size(); ++k) {
+            const ExactKernel::Plane_3& rep = representatives[k];
+            bool coplanar = (exact == rep || exact == rep.opposite());
+
+            if (!coplanar && m_coplanarTolerance > 0.0) {
+                coplanar = nearlyCoplanar(m_partitionPlanes[i], m_partitionPlanes[m_planeSources[k].front()],
+                                          m_coplanarTolerance, diagonal);
+            }
+
+            if (coplanar) {
+                m_planeSources[k].push_back(i);
+                m_stats.mergedPlanes++;
+                merged = true;
+                break;
+            }
+        }
+
+        if (!merged) {
+            m_planeSources.push_back({i});
+            representatives.push_back(exact);
+        }
+    }
+}
+
+void SpacePartitioner::orderPlanes() {
+    if (m_planeOrdering == PlaneOrdering::FileOrder) return;
+    size_t n = m_contourPlanes.size();
+
+    auto signedDistance = [](const Plane& plane, const Point& p) {
+        return plane.a() * p.x() + plane.b() * p.y() + plane.c() * p.z() + plane.d();
+    };
+
+    // Lower score is applied earlier
+    std::vector<double> score(n, 0.0);
+    PlanesSoA planes = toUnitPlanes(m_partitionPlanes);
+    SignMatrix signs;
+
+    if (m_planeOrdering == PlaneOrdering::MostBalanced) {
+        // Every contour vertex against every plane; contour j owns the
+        // points [first[j], first[j + 1])
+        PointsSoA points;
+        std::vector<size_t> first(1, 0);
+        for (const auto& contourPlane : m_contourPlanes) {
+            for (const auto& v : contourPlane.vertices) {
+                points.push_back(v.x(), v.y(), v.z());
+            }
+            first.push_back(points.size());
+        }
+        signs.compute(planes, points);
+
+        // Imbalance of the other contours' vertices on either side
+        for (size_t i = 0; i < n; ++i) {
+            SignMatrix::Counts all = signs.count(i);
+            SignMatrix::Counts own = signs.count(i, first[i], first[i + 1]);
+            size_t positive = all.positive - own.positive;
+            size_t negative = all.negative - own.negative;
+            size_t total = positive + negative;
+            score[i] = total > 0
+                ? std::abs(double(positive) - double(negative)) / double(total)
+                : 1.0;
+        }
+    } else {
+        // Number of other planes crossing this one inside the bounding box
+        auto [min_corner, max_corner] = getBBoxCorners();
+        std::vector<Point> corners;
+        for (int k = 0; k < 8; ++k) {
+            corners.emplace_back((k & 1) ? max_corner.x() : min_corner.x(),
+                                 (k & 2) ? max_corner.y() : min_corner.y(),
+                                 (k & 4) ? max_corner.z() : min_corner.z());
+        }
+
+        // Section of the box with each plane, spanned by corner pair
+        // crossings; plane i owns the points [first[i], first[i + 1])
+        PointsSoA sections;
+        std::vector<size_t> first(1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            const Plane& plane = m_partitionPlanes[i];
+            for (size_t a = 0; a < corners.size(); ++a) {
+                double da = signedDistance(plane, corners[a]);
+                for (size_t b = a + 1; b < corners.size(); ++b) {
+                    double db = signedDistance(plane, corners[b]);
+                    if ((da < 0.0) == (db < 0.0)) continue;
+                    Point p = corners[a] + (da / (da - db)) * (corners[b] - corners[a]);
+                    sections.push_back(p.x(), p.y(), p.z());
                 }
             }
+            first.push_back(sections.size());
         }
-        
-        if (isElementary) {
-            ConvexCell cell;
-            nef.convert_to_polyhedron(cell.geometry);
-            cell.planeIndices.insert(cell.planeIndices.end(), 
-                                   planeSet.begin(), planeSet.end());
-            m_cells.push_back(cell);
+        signs.compute(planes, sections);
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                if (i == j) continue;
+                SignMatrix::Counts counts = signs.count(j, first[i], first[i + 1]);
+                if (counts.positive > 0 && counts.negative > 0) {
+                    score[i] += 1.0;
+                }
+            }
         }
     }
 
-    saveConvexCells(contourName);
+    std::stable_sort(m_planeSources.begin(), m_planeSources.end(),
+                     [&score](const std::vector<size_t>& a, const std::vector<size_t>& b) {
+                         return score[a.front()] < score[b.front()];
+                     });
 }
 
-void SpacePartitioner::precomputePlanes() {
+void SpacePartitioner::setFootprintLocalized(bool enabled, double inflation) {
+    m_footprintLocalized = enabled;
+    m_footprintInflation = inflation;
+}
+
+void SpacePartitioner::precomputeFootprints() {
+    m_footprintFrames.clear();
+    m_footprints.clear();
+    for (const auto& contourPlane : m_contourPlanes) {
+        PlaneFrame frame = PlaneFrame::fromPlane(contourPlane.plane);
+
+        std::vector<Point2> projected;
+        projected.reserve(contourPlane.vertices.size());
+        for (const auto& v : contourPlane.vertices) {
+            projected.push_back(frame.to2d(v));
+        }
+
+        m_footprintFrames.push_back(frame);
+        m_footprints.push_back(inflateConvexPolygon(convexHull2D(projected),
+                                                    m_footprintInflation));
+    }
+}
+
+bool SpacePartitioner::nodeTouchesFootprint(const Nef_polyhedron& space, size_t contourIndex) const {
+    const auto& footprint = m_footprints[contourIndex];
+    if (footprint.size() < 3) return true;  // Degenerate contour, keep the full cut
+
+    std::vector<Point> vertices;
+    for (auto v = space.vertices_begin(); v != space.vertices_end(); ++v) {
+        if (!space.is_standard(v)) continue;  // Corner of the infimaximal box
+        vertices.emplace_back(CGAL::to_double(v->point().x()),
+                              CGAL::to_double(v->point().y()),
+                              CGAL::to_double(v->point().z()));
+    }
+
+    std::vector<Point2> sectionHull = convexSection(vertices, m_partitionPlanes[contourIndex],
+                                                    m_footprintFrames[contourIndex], 0.0);
+    if (sectionHull.size() < 3) return true;
+
+    return convexPolygonsOverlap(sectionHull, footprint);
+}
+
+bool SpacePartitioner::nodeTouchesAnyFootprint(const Nef_polyhedron& space, size_t planeIndex) const {
+    for (size_t contourIndex : m_planeSources[planeIndex]) {
+        if (nodeTouchesFootprint(space, contourIndex)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SpacePartitioner::partitionSpace(Nef_polyhedron root,
+                                      int32_t rootNode,
+                                      const std::vector<size_t>& splitters,
+                                      const std::set<size_t>& rootPlanes) {
+    std::vector<PartitionNode> stack;
+    stack.emplace_back();
+    stack.back().space = std::move(root);
+    stack.back().treeNode = rootNode;
+    stack.back().planes = rootPlanes;
+    traverseNodes(stack, splitters, 0.0);
+}
+
+void SpacePartitioner::traverseNodes(std::vector<PartitionNode>& stack,
+                                     const std::vector<size_t>& splitters,
+                                     double finishedWeight) {
+    // A cancelled traversal leaves a consistent frontier behind, which is
+    // kept so that the next partition() can resume it
+    try {
+        traverseStack(stack, splitters, finishedWeight);
+    } catch (const OperationCancelled&) {
+        if (!m_checkpointPath.empty()) {
+            writeCheckpoint(stack, finishedWeight);
+        }
+        throw;
+    }
+}
+
+void SpacePartitioner::traverseStack(std::vector<PartitionNode>& stack,
+                                     const std::vector<size_t>& splitters,
+                                     double& finishedWeight) {
+    // Depth-first traversal with an explicit stack: at most one pending
+    // sibling per level, so the stack never grows beyond the tree depth.
+    // node.planeIndex walks 'splitters', which index m_exactPlanes.
+    // Progress is the summed weight of finished nodes, a node weighing
+    // 2^-depth of the root.
+    size_t liveNodes = std::count_if(stack.begin(), stack.end(), [](const PartitionNode& node) {
+        return !node.isParked && !node.isDeferred;
+    });
+
+    while (!stack.empty()) {
+        m_progress.checkCancelled();
+        if (!m_checkpointPath.empty() &&
+            std::chrono::steady_clock::now() - m_lastCheckpoint >
+                std::chrono::duration<double>(m_checkpointInterval)) {
+            writeCheckpoint(stack, finishedWeight);
+            m_lastCheckpoint = std::chrono::steady_clock::now();
+        }
+
+        PartitionNode node = std::move(stack.back());
+        stack.pop_back();
+
+        if (node.isDeferred) {
+            node.space = materializeNode(node.treeNode);
+            node.isDeferred = false;
+        } else if (node.isParked) {
+            node.space = Nef_polyhedron(node.parked);
+            node.parked.clear();
+            node.isParked = false;
+        } else {
+            liveNodes--;
+        }
+
+        if (node.space.is_empty() || node.space.number_of_vertices() == 0) {
+            finishedWeight += node.weight;
+            m_progress.report(finishedWeight);
+            continue;
+        }
+
+        if (node.planeIndex >= splitters.size()) {
+            m_tree[node.treeNode].cell = static_cast<int32_t>(m_cells.size());
+            emitCell(node.space, node.planes);
+            finishedWeight += node.weight;
+            m_progress.report(finishedWeight);
+            continue;
+        }
+
+        size_t splitter = splitters[node.planeIndex];
+        const ExactKernel::Plane_3& exact_plane = m_exactPlanes[splitter];
+
+        // Plane does not cut this node: pass it on to the next plane as is
+        if (classifyNode(node.space, exact_plane) != CGAL::ON_ORIENTED_BOUNDARY) {
+            m_stats.skippedSplits++;
+            node.planeIndex++;
+            stack.push_back(std::move(node));
+            liveNodes++;
+            continue;
+        }
+
+        if (m_footprintLocalized && !nodeTouchesAnyFootprint(node.space, splitter)) {
+            m_stats.footprintSkips++;
+            node.planeIndex++;
+            stack.push_back(std::move(node));
+            liveNodes++;
+            continue;
+        }
+
+        m_stats.exactSplits++;
+        Nef_polyhedron plane_nef(exact_plane, Nef_polyhedron::INCLUDED);
+
+        // plane_nef is the closed halfspace on the negative side of the plane
+        PartitionNode below;
+        below.space = node.space * plane_nef;
+        below.planeIndex = node.planeIndex + 1;
+
+        PartitionNode above;
+        above.space = node.space * plane_nef.complement();
+        above.planeIndex = node.planeIndex + 1;
+
+        // Release the parent before its children are queued
+        node.space.clear();
+
+        bool hasBelow = !below.space.is_empty() && below.space.number_of_vertices() > 0;
+        bool hasAbove = !above.space.is_empty() && above.space.number_of_vertices() > 0;
+
+        below.planes = node.planes;
+        above.planes = node.planes;
+        below.treeNode = node.treeNode;
+        above.treeNode = node.treeNode;
+        below.weight = hasAbove ? 0.5 * node.weight : node.weight;
+        above.weight = hasBelow ? 0.5 * node.weight : node.weight;
+        if (!hasBelow && !hasAbove) {
+            finishedWeight += node.weight;
+            m_progress.report(finishedWeight);
+        }
+
+        // Only a plane that actually cuts the node bounds the resulting
+        // cells and becomes a node of the tree
+        if (hasBelow && hasAbove) {
+            const auto& sources = m_planeSources[splitter];
+            below.planes.insert(sources.begin(), sources.end());
+            above.planes.insert(sources.begin(), sources.end());
+
+            int32_t parent = node.treeNode;
+            below.treeNode = static_cast<int32_t>(m_tree.size());
+            above.treeNode = below.treeNode + 1;
+            m_tree.resize(m_tree.size() + 2);
+            m_tree[below.treeNode].parent = parent;
+            m_tree[above.treeNode].parent = parent;
+            m_tree[parent].splitter = static_cast<int32_t>(splitter);
+            m_tree[parent].below = below.treeNode;
+            m_tree[parent].above = above.treeNode;
+        }
+
+        // Negative side is pushed last so it is processed first
+        if (hasAbove) {
+            stack.push_back(std::move(above));
+            liveNodes++;
+        }
+        if (hasBelow) {
+            stack.push_back(std::move(below));
+            liveNodes++;
+        }
+
+        parkNodes(stack, liveNodes);
+    }
+}
+
+CGAL::Oriented_side SpacePartitioner::classifyNode(const Nef_polyhedron& space,
+                                                  const ExactKernel::Plane_3& plane) {
+    // Side holding the whole node (vertices on the plane count for either
+    // side), or ON_ORIENTED_BOUNDARY when the plane cuts it (a flat node on
+    // the plane is left to the exact split). The corners of the infimaximal
+    // box are vertices of every extended Nef but not of the node itself.
+    FilteredPlane filtered(plane, m_integerSnapping ? &m_stats.integerPredicates : nullptr);
+    bool hasPositive = false;
+    bool hasNegative = false;
+    for (auto v = space.vertices_begin(); v != space.vertices_end(); ++v) {
+        if (!space.is_standard(v)) continue;
+
+        CGAL::Oriented_side side = filtered.side(v->point(), m_stats.exactPredicates);
+        hasPositive |= (side == CGAL::ON_POSITIVE_SIDE);
+        hasNegative |= (side == CGAL::ON_NEGATIVE_SIDE);
+        if (hasPositive && hasNegative) {
+            return CGAL::ON_ORIENTED_BOUNDARY;
+        }
+    }
+
+    if (hasPositive) return CGAL::ON_POSITIVE_SIDE;
+    if (hasNegative) return CGAL::ON_NEGATIVE_SIDE;
+    return CGAL::ON_ORIENTED_BOUNDARY;
+}
+
+void SpacePartitioner::parkNodes(std::vector<PartitionNode>& stack, size_t& liveNodes) const {
+    if (m_maxInFlightNodes == 0) return;
+
+    // Park the nodes deepest in the stack first, they are needed last
+    for (auto& node : stack) {
+        if (liveNodes <= m_maxInFlightNodes) break;
+        if (node.isParked || node.isDeferred) continue;
+
+        node.space.convert_to_polyhedron(node.parked);
+        node.space.clear();
+        node.isParked = true;
+        liveNodes--;
+    }
+}
+
+void SpacePartitioner::emitCell(const Nef_polyhedron& space, const std::set<size_t>& planes) {
+    ExactPolyhedron poly;
+    space.convert_to_polyhedron(poly);
+
+    // Only the compact copy is kept, the exact geometry can be rebuilt
+    // from the tree with getExactGeometry()
+    ConvexCell cell = makeConvexCell(poly);
+    cell.planeIndices.assign(planes.begin(), planes.end());
+    m_cells.push_back(std::move(cell));
+}
+
+void SpacePartitioner::filterElementaryCells() {
+    // A cell is not elementary when all of its vertices lie inside another
+    // cell, which is what degenerate (flat) leaves of the traversal look like
+    const auto& [min_corner, max_corner] = m_treeBounds;
+    double tolerance = 1e-9 * std::sqrt(CGAL::squared_distance(min_corner, max_corner));
+
+    std::vector<std::vector<Plane>> faces;
+    for (const auto& cell : m_cells) {
+        faces.push_back(computeFacePlanes(cell));
+    }
+
+    std::vector<bool> isElementary(m_cells.size(), true);
+    for (size_t i = 0; i < m_cells.size(); ++i) {
+        m_progress.report(double(i) / m_cells.size());
+        for (size_t j = 0; j < m_cells.size() && isElementary[i]; ++j) {
+            if (i == j || !isElementary[j]) continue;
+            if (!CGAL::do_overlap(m_cells[i].bbox, m_cells[j].bbox)) continue;
+
+            bool contained = true;
+            for (const auto& v : m_cells[i].vertices) {
+                if (!cellContains(faces[j], v, tolerance)) {
+                    contained = false;
+                    break;
+                }
+            }
+            if (contained) {
+                isElementary[i] = false;
+            }
+        }
+    }
+
+    std::vector<int32_t> remap(m_cells.size(), -1);
+    std::vector<ConvexCell> elementary;
+    elementary.reserve(m_cells.size());
+    for (size_t i = 0; i < m_cells.size(); ++i) {
+        if (isElementary[i]) {
+            remap[i] = static_cast<int32_t>(elementary.size());
+            elementary.push_back(std::move(m_cells[i]));
+        }
+    }
+    m_cells = std::move(elementary);
+
+    for (auto& treeNode : m_tree) {
+        if (treeNode.cell >= 0) {
+            treeNode.cell = remap[treeNode.cell];
+        }
+    }
+}
+
+void SpacePartitioner::ensureExactPlanes() {
+    // Split planes read from the cache carry the input coefficients, so
+    // their exact counterparts can be rebuilt without loss
+    if (m_exactPlanes.size() == m_splitPlanes.size()) return;
+
     IK_to_EK to_exact;
-    m_exactPlanes.reserve(m_contourPlanes.size());
-    for (const auto& plane : m_contourPlanes) {
-        m_exactPlanes.push_back(to_exact(plane.plane));
+    m_exactPlanes.clear();
+    for (const auto& plane : m_splitPlanes) {
+        m_exactPlanes.push_back(to_exact(plane));
     }
 }
 
-void SpacePartitioner::partitionSpace(
-    Nef_polyhedron& space,
-    size_t planeIndex,
-    std::vector<std::pair<Nef_polyhedron, std::set<size_t>>>& nefPolys) {
-    
-    if (space.is_empty() || space.number_of_vertices() == 0) {
-        return;
+Nef_polyhedron SpacePartitioner::materializeNode(int32_t treeNode) const {
+    // A node is the root box cut by the halfspaces on its path to the root
+    IK_to_EK to_exact;
+    Nef_polyhedron space = computeBoundingBox();
+    for (int32_t child = treeNode, parent = m_tree[treeNode].parent;
+         parent >= 0;
+         child = parent, parent = m_tree[parent].parent) {
+        Nef_polyhedron halfspace(to_exact(m_splitPlanes[m_tree[parent].splitter]),
+                                 Nef_polyhedron::INCLUDED);
+        space *= (m_tree[parent].below == child) ? halfspace : halfspace.complement();
     }
-    
-    if (planeIndex >= m_exactPlanes.size()) {
-        nefPolys.push_back({space, std::set<size_t>()});
-        return;
+    return space;
+}
+
+std::set<size_t> SpacePartitioner::pathPlanes(int32_t treeNode) const {
+    std::set<size_t> planes;
+    for (int32_t parent = m_tree[treeNode].parent; parent >= 0; parent = m_tree[parent].parent) {
+        const auto& sources = m_planeSources[m_tree[parent].splitter];
+        planes.insert(sources.begin(), sources.end());
     }
-    
-    const ExactKernel::Plane_3& exact_plane = m_exactPlanes[planeIndex];
-    Nef_polyhedron plane_nef(exact_plane, Nef_polyhedron::INCLUDED);
-    
-    Nef_polyhedron positive_space = space * plane_nef;
-    if (!positive_space.is_empty() && positive_space.number_of_vertices() > 0) {
-        std::set<size_t> pos_planes;
-        if (!nefPolys.empty()) {
-            pos_planes = nefPolys.back().second;
+    return planes;
+}
+
+void SpacePartitioner::insertPlane(const ContourPlane& contourPlane) {
+    if (m_tree.empty()) {
+        throw std::runtime_error("insertPlane needs a partition with a BSP tree");
+    }
+    ensureExactPlanes();
+
+    Plane partitionPlane = contourPlane.plane;
+    if (m_integerSnapping) {
+        partitionPlane = snapPlane(contourPlane);
+        m_snapError = std::max(m_snapError, maxPlaneDistance(partitionPlane, contourPlane.vertices));
+    }
+
+    IK_to_EK to_exact;
+    size_t contourIndex = m_contourPlanes.size();
+    m_contourPlanes.push_back(contourPlane);
+    m_partitionPlanes.push_back(partitionPlane);
+    m_contourStore.reset();
+    if (m_footprintLocalized) {
+        precomputeFootprints();
+    }
+
+    // A plane coinciding with an existing splitter, exactly or within the
+    // tolerance partition() merges with, changes no geometry. The cells
+    // with a face on an identical splitter have one on the new plane too,
+    // but the new contour crosses cells of its own.
+    ExactKernel::Plane_3 exact = to_exact(partitionPlane);
+    auto [boxMin, boxMax] = getBBoxCorners();
+    double diagonal = std::sqrt(CGAL::squared_distance(boxMin, boxMax));
+    for (size_t k = 0; k < m_exactPlanes.size(); ++k) {
+        bool identical = exact == m_exactPlanes[k] || exact == m_exactPlanes[k].opposite();
+        if (identical || (m_coplanarTolerance > 0.0 &&
+                          nearlyCoplanar(partitionPlane, m_splitPlanes[k], m_coplanarTolerance, diagonal))) {
+            size_t representative = m_splitContours[k];
+            m_planeSources[k].push_back(contourIndex);
+            m_stats.mergedPlanes++;
+
+            double tolerance = contourTolerance();
+            CGAL::Bbox_3 contourBox = CGAL::bbox_3(contourPlane.vertices.begin(),
+                                                   contourPlane.vertices.end());
+            for (auto& cell : m_cells) {
+                // contourIndex is the largest index, appending keeps the lists sorted
+                if (identical && std::find(cell.facePlanes.begin(), cell.facePlanes.end(),
+                                           representative) != cell.facePlanes.end()) {
+                    cell.facePlanes.push_back(contourIndex);
+                }
+                if (contourCrossesCell(contourPlane, contourBox, cell.bbox, computeFacePlanes(cell),
+                                       tolerance)) {
+                    cell.planeIndices.push_back(contourIndex);
+                }
+            }
+            return;
+        }
+    }
+
+    size_t splitter = m_exactPlanes.size();
+    m_exactPlanes.push_back(exact);
+    m_splitPlanes.push_back(partitionPlane);
+    m_splitContours.push_back(contourIndex);
+    m_planeSources.push_back({contourIndex});
+
+    // Only leaves the plane crosses are split, each one in place. The
+    // compact vertices are rounded, so only cells clearly on one side are
+    // skipped here; partitionSpace decides the others exactly.
+    const Plane& plane = partitionPlane;
+    double norm = std::sqrt(plane.orthogonal_vector().squared_length());
+    const auto& [min_corner, max_corner] = m_treeBounds;
+    double tolerance = 1e-9 * std::sqrt(CGAL::squared_distance(min_corner, max_corner));
+
+    std::vector<bool> deadCells(m_cells.size(), false);
+    size_t firstNewCell = m_cells.size();
+    size_t leafCount = m_tree.size();
+    size_t splitCount = 0;
+    for (size_t n = 0; n < leafCount; ++n) {
+        int32_t cellIndex = m_tree[n].cell;
+        if (m_tree[n].splitter >= 0 || cellIndex < 0) continue;
+
+        bool hasPositive = false, hasNegative = false;
+        for (const auto& p : m_cells[cellIndex].vertices) {
+            double d = (plane.a() * p.x() + plane.b() * p.y() + plane.c() * p.z() + plane.d()) / norm;
+            hasPositive |= d > -tolerance;
+            hasNegative |= d < tolerance;
         }
-        pos_planes.insert(planeIndex);
-        partitionSpace(positive_space, planeIndex + 1, nefPolys);
-        if (!nefPolys.empty()) {
-            nefPolys.back().second = pos_planes;
+        if (!hasPositive || !hasNegative) continue;
+
+        std::set<size_t> planes(m_cells[cellIndex].planeIndices.begin(),
+                                m_cells[cellIndex].planeIndices.end());
+        deadCells[cellIndex] = true;
+        m_tree[n].cell = -1;
+        size_t firstNew = m_cells.size();
+        partitionSpace(materializeNode(static_cast<int32_t>(n)), static_cast<int32_t>(n),
+                       {splitter}, planes);
+        if (m_tree[n].splitter >= 0) {
+            splitCount++;
+        }
+
+        // A leaf that only touches the plane may still come back with a
+        // flat piece on it; filterElementaryCells() does not run here, so
+        // such pieces are dropped directly
+        deadCells.resize(m_cells.size(), false);
+        for (size_t i = firstNew; i < m_cells.size(); ++i) {
+            bool flat = true;
+            for (const auto& p : m_cells[i].vertices) {
+                double d = (plane.a() * p.x() + plane.b() * p.y() + plane.c() * p.z() + plane.d()) / norm;
+                if (std::abs(d) > tolerance) {
+                    flat = false;
+                    break;
+                }
+            }
+            if (flat) {
+                deadCells[i] = true;
+            }
         }
     }
-    
-    space *= plane_nef.complement();
-    if (!space.is_empty() && space.number_of_vertices() > 0) {
-        partitionSpace(space, planeIndex + 1, nefPolys);
+
+    // The cells left whole keep their incidence; the new contour may
+    // still cross them. contourIndex is the largest index, appending
+    // keeps the lists sorted.
+    double crossTolerance = contourTolerance();
+    CGAL::Bbox_3 contourBox = CGAL::bbox_3(contourPlane.vertices.begin(), contourPlane.vertices.end());
+    for (size_t i = 0; i < firstNewCell; ++i) {
+        if (deadCells[i]) continue;
+        ConvexCell& cell = m_cells[i];
+        if (contourCrossesCell(contourPlane, contourBox, cell.bbox, computeFacePlanes(cell),
+                               crossTolerance)) {
+            cell.planeIndices.push_back(contourIndex);
+        }
+    }
+
+    replaceCells(deadCells, firstNewCell);
+
+    std::cout << "Inserted plane " << contourIndex << ", split " << splitCount
+              << " cells" << std::endl;
+}
+
+bool SpacePartitioner::removePlane(size_t contourIndex) {
+    if (contourIndex >= m_contourPlanes.size()) return false;
+    if (m_tree.empty()) {
+        throw std::runtime_error("removePlane needs a partition with a BSP tree");
+    }
+    ensureExactPlanes();
+
+    // The rebuilt subtrees may cut by footprint, and a partition read from
+    // the cache has none yet
+    if (m_footprintLocalized) {
+        precomputeFootprints();
+    }
+
+    auto findSource = [&](size_t k) {
+        return std::find(m_planeSources[k].begin(), m_planeSources[k].end(), contourIndex);
+    };
+
+    size_t splitter = m_planeSources.size();
+    for (size_t k = 0; k < m_planeSources.size(); ++k) {
+        if (findSource(k) != m_planeSources[k].end()) {
+            splitter = k;
+            break;
+        }
+    }
+
+    std::vector<bool> deadCells(m_cells.size(), false);
+    size_t firstNewCell = m_cells.size();
+    size_t mergedCount = 0;
+
+    if (splitter < m_planeSources.size() && m_planeSources[splitter].size() > 1) {
+        // Other coplanar contours keep the splitter alive. Its plane is the
+        // one that cut the tree, which a contour merged within tolerance
+        // does not reproduce exactly, so only the source is dropped.
+        m_planeSources[splitter].erase(findSource(splitter));
+        m_splitContours[splitter] = m_planeSources[splitter].front();
+        for (auto& edge : m_adjacency) {
+            if (edge.planeIndex == contourIndex) edge.planeIndex = m_splitContours[splitter];
+        }
+    } else if (splitter < m_planeSources.size()) {
+        // Rebuild every subtree rooted at the removed splitter from the
+        // splitters used below it; the rest of the tree is untouched
+        size_t nodeCount = m_tree.size();
+        for (size_t n = 0; n < nodeCount; ++n) {
+            if (m_tree[n].splitter != static_cast<int32_t>(splitter)) continue;
+
+            std::set<size_t> subSplitters;
+            std::vector<int32_t> pending = {m_tree[n].below, m_tree[n].above};
+            while (!pending.empty()) {
+                int32_t m = pending.back();
+                pending.pop_back();
+                if (m_tree[m].splitter >= 0) {
+                    subSplitters.insert(m_tree[m].splitter);
+                    pending.push_back(m_tree[m].below);
+                    pending.push_back(m_tree[m].above);
+                } else if (m_tree[m].cell >= 0) {
+                    deadCells[m_tree[m].cell] = true;
+                    mergedCount++;
+                }
+                m_tree[m].parent = -1;  // Detached, dropped by compactPartition
+            }
+
+            m_tree[n].splitter = -1;
+            m_tree[n].below = -1;
+            m_tree[n].above = -1;
+            m_tree[n].cell = -1;
+            partitionSpace(materializeNode(static_cast<int32_t>(n)), static_cast<int32_t>(n),
+                           std::vector<size_t>(subSplitters.begin(), subSplitters.end()),
+                           pathPlanes(static_cast<int32_t>(n)));
+        }
+
+        // Drop the splitter itself
+        m_exactPlanes.erase(m_exactPlanes.begin() + splitter);
+        m_splitPlanes.erase(m_splitPlanes.begin() + splitter);
+        m_splitContours.erase(m_splitContours.begin() + splitter);
+        m_planeSources.erase(m_planeSources.begin() + splitter);
+        for (auto& node : m_tree) {
+            if (node.splitter > static_cast<int32_t>(splitter)) node.splitter--;
+        }
+    }
+
+    // Drop the contour and shift the indices after it
+    m_contourPlanes.erase(m_contourPlanes.begin() + contourIndex);
+    m_partitionPlanes.erase(m_partitionPlanes.begin() + contourIndex);
+    m_contourStore.reset();
+    auto shift = [contourIndex](std::vector<size_t>& indices) {
+        indices.erase(std::remove(indices.begin(), indices.end(), contourIndex), indices.end());
+        for (auto& idx : indices) {
+            if (idx > contourIndex) idx--;
+        }
+    };
+    for (auto& cell : m_cells) {
+        shift(cell.planeIndices);
+        shift(cell.facePlanes);
+    }
+    for (auto& sources : m_planeSources) shift(sources);
+    for (auto& idx : m_splitContours) {
+        if (idx > contourIndex) idx--;
+    }
+    for (auto& edge : m_adjacency) {
+        if (edge.planeIndex > contourIndex) edge.planeIndex--;
     }
+    if (m_footprintLocalized) {
+        m_footprints.erase(m_footprints.begin() + contourIndex);
+        m_footprintFrames.erase(m_footprintFrames.begin() + contourIndex);
+    }
+
+    replaceCells(deadCells, firstNewCell);
+
+    std::cout << "Removed plane " << contourIndex << ", merged " << mergedCount
+              << " cells" << std::endl;
+    return true;
+}
+
+void SpacePartitioner::replaceCells(std::vector<bool> deadCells, size_t firstNewCell) {
+    deadCells.resize(m_cells.size(), false);
+
+    // The neighbours of a replaced cell keep their geometry, only their
+    // links to it change. They are found from the graph before it is
+    // compacted.
+    std::vector<bool> neighbour(m_cells.size(), false);
+    for (size_t i = 0; i < firstNewCell; ++i) {
+        if (!deadCells[i]) continue;
+        for (size_t e : m_cellAdjacency[i]) {
+            neighbour[m_adjacency[e].cellBelow] = true;
+            neighbour[m_adjacency[e].cellAbove] = true;
+        }
+    }
+
+    std::vector<int32_t> cellRemap = compactPartition(deadCells);
+
+    std::vector<size_t> newCells, linked;
+    std::vector<bool> isNew(m_cells.size(), false);
+    for (size_t i = 0; i < cellRemap.size(); ++i) {
+        if (cellRemap[i] < 0) continue;
+        size_t cell = static_cast<size_t>(cellRemap[i]);
+        if (i >= firstNewCell) {
+            isNew[cell] = true;
+            newCells.push_back(cell);
+            linked.push_back(cell);
+        } else if (neighbour[i]) {
+            linked.push_back(cell);
+        }
+    }
+
+    linkCells(linked, isNew);
+    indexAdjacency();
+    computeIncidence(newCells);
+}
+
+std::vector<int32_t> SpacePartitioner::compactPartition(const std::vector<bool>& deadCells) {
+    std::vector<int32_t> cellRemap(m_cells.size(), -1);
+    std::vector<ConvexCell> cells;
+    cells.reserve(m_cells.size());
+    for (size_t i = 0; i < m_cells.size(); ++i) {
+        if (!deadCells[i]) {
+            cellRemap[i] = static_cast<int32_t>(cells.size());
+            cells.push_back(std::move(m_cells[i]));
+        }
+    }
+    m_cells = std::move(cells);
+
+    // Edges to a dead cell go with it
+    std::vector<CellAdjacency> adjacency;
+    for (auto& edge : m_adjacency) {
+        if (cellRemap[edge.cellBelow] < 0 || cellRemap[edge.cellAbove] < 0) continue;
+        edge.cellBelow = static_cast<size_t>(cellRemap[edge.cellBelow]);
+        edge.cellAbove = static_cast<size_t>(cellRemap[edge.cellAbove]);
+        adjacency.push_back(std::move(edge));
+    }
+    m_adjacency = std::move(adjacency);
+
+    // Keep the nodes reachable from the root, in depth-first order
+    std::vector<BSPNode> tree;
+    std::vector<std::pair<int32_t, int32_t>> pending = {{0, -1}};  // (old node, new parent)
+    while (!pending.empty()) {
+        auto [old, parent] = pending.back();
+        pending.pop_back();
+
+        int32_t index = static_cast<int32_t>(tree.size());
+        BSPNode node = m_tree[old];
+        node.parent = parent;
+        node.cell = node.cell >= 0 ? cellRemap[node.cell] : -1;
+        tree.push_back(node);
+
+        if (parent >= 0) {
+            BSPNode& p = tree[parent];
+            if (p.below == -2) p.below = index; else p.above = index;
+        }
+        if (node.splitter >= 0) {
+            // Children are linked when they are visited, below first
+            tree[index].below = -2;
+            tree[index].above = -2;
+            pending.push_back({m_tree[old].above, index});
+            pending.push_back({m_tree[old].below, index});
+        }
+    }
+    m_tree = std::move(tree);
+    return cellRemap;
+}
+
+std::vector<Plane> SpacePartitioner::computeFacePlanes(const ConvexCell& cell) {
+    std::vector<Plane> planes;
+    planes.reserve(cell.faces.size());
+    for (const auto& face : cell.faces) {
+        // Newell's method, robust for polygons with collinear vertices
+        Vector normal(0, 0, 0);
+        Vector centroid(0, 0, 0);
+        for (size_t i = 0; i < face.size(); ++i) {
+            const Point& p = cell.vertices[face[i]];
+            const Point& q = cell.vertices[face[(i + 1) % face.size()]];
+            normal = normal + Vector((p.y() - q.y()) * (p.z() + q.z()),
+                                     (p.z() - q.z()) * (p.x() + q.x()),
+                                     (p.x() - q.x()) * (p.y() + q.y()));
+            centroid = centroid + (p - CGAL::ORIGIN);
+        }
+
+        double length = std::sqrt(normal.squared_length());
+        if (length == 0.0 || face.empty()) continue;
+
+        normal = normal / length;
+        centroid = centroid / static_cast<double>(face.size());
+        planes.emplace_back(normal.x(), normal.y(), normal.z(), -(normal * centroid));
+    }
+    return planes;
+}
+
+ExactPolyhedron SpacePartitioner::getExactGeometry(size_t cellIndex) const {
+    ExactPolyhedron poly;
+    if (cellIndex >= m_cells.size()) return poly;
+
+    for (size_t n = 0; n < m_tree.size(); ++n) {
+        if (m_tree[n].splitter < 0 && m_tree[n].cell == static_cast<int32_t>(cellIndex)) {
+            materializeNode(static_cast<int32_t>(n)).convert_to_polyhedron(poly);
+            return poly;
+        }
+    }
+
+    // Without a tree the stored (rounded) vertices are all that is left
+    IK_to_EK to_exact;
+    std::vector<ExactPoint> points;
+    for (const auto& v : m_cells[cellIndex].vertices) {
+        points.push_back(to_exact(v));
+    }
+    CGAL::convex_hull_3(points.begin(), points.end(), poly);
+    return poly;
+}
+
+void SpacePartitioner::computeIncidence() {
+    std::vector<size_t> cells(m_cells.size());
+    std::iota(cells.begin(), cells.end(), 0);
+    computeIncidence(cells);
+}
+
+void SpacePartitioner::computeIncidence(const std::vector<size_t>& cells) {
+    auto [min_corner, max_corner] = getBBoxCorners();
+    double diagonal = std::sqrt(CGAL::squared_distance(min_corner, max_corner));
+    double faceTolerance = 1e-9 * diagonal;  // Cell vertices are exact up to rounding
+    double tolerance = contourTolerance();
+
+    // Cell faces lie on the planes the contours were partitioned on
+    PlanesSoA contourPlanes = toUnitPlanes(m_partitionPlanes);
+    PointsSoA points;
+    SignMatrix signs;
+
+    // Contour bounding boxes for a cheap rejection per cell
+    std::vector<CGAL::Bbox_3> contourBoxes;
+    for (const auto& contourPlane : m_contourPlanes) {
+        contourBoxes.push_back(CGAL::bbox_3(contourPlane.vertices.begin(),
+                                            contourPlane.vertices.end()));
+    }
+
+    for (size_t i = 0; i < cells.size(); ++i) {
+        m_progress.report(double(i) / cells.size());
+        ConvexCell& cell = m_cells[cells[i]];
+        cell.planeIndices.clear();
+        cell.facePlanes.clear();
+
+        const CGAL::Bbox_3& cellBox = cell.bbox;
+        std::vector<Plane> faces = computeFacePlanes(cell);
+
+        points.clear();
+        for (const auto& p : cell.vertices) {
+            points.push_back(p.x(), p.y(), p.z());
+        }
+        signs.compute(contourPlanes, points, faceTolerance);
+
+        for (size_t c = 0; c < m_contourPlanes.size(); ++c) {
+            // Input plane supporting a face: at least three cell vertices on it
+            if (signs.count(c).onPlane >= 3) {
+                cell.facePlanes.push_back(c);
+            }
+
+            if (contourCrossesCell(m_contourPlanes[c], contourBoxes[c], cellBox, faces, tolerance)) {
+                cell.planeIndices.push_back(c);
+            }
+        }
+    }
+}
+
+std::vector<size_t> SpacePartitioner::updateContour(size_t contourIndex, const ContourPlane& input) {
+    if (contourIndex >= m_contourPlanes.size()) {
+        throw std::runtime_error("updateContour: contour index out of range");
+    }
+
+    // The split planes stay as they are, so only vertices and edges may
+    // change. A snapped splitter is kept too, the snapping error grows if
+    // the new vertices lie farther from it.
+    if (input.plane != m_contourPlanes[contourIndex].plane) {
+        throw std::runtime_error("updateContour: the contour plane changed, a new partition is needed");
+    }
+    if (m_integerSnapping) {
+        m_snapError = std::max(m_snapError, maxPlaneDistance(m_partitionPlanes[contourIndex],
+                                                             input.vertices));
+    }
+    m_contourPlanes[contourIndex] = input;
+    m_contourStore.reset();
+    if (m_footprintLocalized) {
+        precomputeFootprints();
+    }
+
+    // Incidence of this contour only; the other contours keep theirs
+    double tolerance = contourTolerance();
+    const ContourPlane& contour = m_contourPlanes[contourIndex];
+    CGAL::Bbox_3 contourBox = CGAL::bbox_3(contour.vertices.begin(), contour.vertices.end());
+
+    std::vector<size_t> affected;
+    for (size_t cellIndex = 0; cellIndex < m_cells.size(); ++cellIndex) {
+        ConvexCell& cell = m_cells[cellIndex];
+        auto it = std::lower_bound(cell.planeIndices.begin(), cell.planeIndices.end(), contourIndex);
+        bool wasCrossing = it != cell.planeIndices.end() && *it == contourIndex;
+        bool crosses = contourCrossesCell(contour, contourBox, cell.bbox, computeFacePlanes(cell),
+                                          tolerance);
+        if (crosses && !wasCrossing) {
+            cell.planeIndices.insert(it, contourIndex);
+        } else if (!crosses && wasCrossing) {
+            cell.planeIndices.erase(it);
+        }
+        if (crosses || wasCrossing) {
+            affected.push_back(cellIndex);
+        }
+    }
+    return affected;
 }
 
 std::vector<ContourPlane> SpacePartitioner::getPlanesForCell(size_t cellIndex) const {
@@ -240,10 +2101,15 @@ std::vector<ContourPlane> SpacePartitioner::getPlanesForCell(size_t cellIndex) c
     return planes;
 }
 
+std::shared_ptr<const std::vector<ContourPlane>> SpacePartitioner::getContourStore() const {
+    if (!m_contourStore) {
+        m_contourStore = std::make_shared<const std::vector<ContourPlane>>(m_contourPlanes);
+    }
+    return m_contourStore;
+}
+
 
 void SpacePartitioner::renderPolyhedron(const ConvexCell& cell, bool highlight) const {
-    EK_to_IK to_inexact;
-    
     if (highlight) {
         glColor3f(1.0f, 0.0f, 0.0f); // Red for highlighted cells
     } else {
@@ -251,17 +2117,19 @@ void SpacePartitioner::renderPolyhedron(const ConvexCell& cell, bool highlight)
     }
     glLineWidth(2.0f);
 
-    for (auto e = cell.geometry.edges_begin(); e != cell.geometry.edges_end(); ++e) {
-        Point v1 = to_inexact(e->vertex()->point());
-        Point v2 = to_inexact(e->opposite()->vertex()->point());
+    // Every edge is shared by two faces, draw it from one of them only
+    glBegin(GL_LINES);
+    for (const auto& face : cell.faces) {
+        for (size_t i = 0; i < face.size(); ++i) {
+            size_t a = face[i];
+            size_t b = face[(i + 1) % face.size()];
+            if (a > b) continue;
 
-        glBegin(GL_LINES);
-        glVertex3d(CGAL::to_double(v1.x()), 
-                  CGAL::to_double(v1.y()), 
-                  CGAL::to_double(v1.z()));
-        glVertex3d(CGAL::to_double(v2.x()), 
-                  CGAL::to_double(v2.y()), 
-                  CGAL::to_double(v2.z()));
-        glEnd();
+            const Point& v1 = cell.vertices[a];
+            const Point& v2 = cell.vertices[b];
+            glVertex3d(v1.x(), v1.y(), v1.z());
+            glVertex3d(v2.x(), v2.y(), v2.z());
+        }
     }
+    glEnd();
 }
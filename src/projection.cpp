@@ -1,40 +1,318 @@
 // projection.cpp
 #include "projection.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
 #include <vector>
 #include <CGAL/Polyhedron_3.h>
 #include <CGAL/bounding_box.h>
 #include <CGAL/Cartesian_converter.h>
 #include <GL/glew.h>
 #include "partition.h"
+#include "sign_matrix.h"
 
-Projection::Projection(const SpacePartitioner& partitioner) {
+namespace {
+
+// Plane through an axis-aligned projection plane, normal along its axis
+Plane toPlane(const AxisPlanes::Plane& plane) {
+    switch (plane.axis) {
+        case 'x': return Plane(1, 0, 0, -plane.position);
+        case 'y': return Plane(0, 1, 0, -plane.position);
+        default:  return Plane(0, 0, 1, -plane.position);
+    }
+}
+
+// Part of a contour inside one cell
+struct ClippedContour {
+    std::vector<Point> vertices;
+    std::vector<std::pair<int, int>> edges;
+};
+
+// Even-odd test of a point against the contour edges, all in the contour frame
+bool insideContour(const std::vector<Point2>& contour, const std::vector<std::pair<int, int>>& edges,
+                   const Point2& p) {
+    bool inside = false;
+    for (const auto& edge : edges) {
+        if (static_cast<size_t>(edge.first) >= contour.size() ||
+            static_cast<size_t>(edge.second) >= contour.size()) continue;
+        const Point2& a = contour[edge.first];
+        const Point2& b = contour[edge.second];
+        if ((a.y() > p.y()) == (b.y() > p.y())) continue;
+        double x = a.x() + (p.y() - a.y()) / (b.y() - a.y()) * (b.x() - a.x());
+        if (x > p.x()) inside = !inside;
+    }
+    return inside;
+}
+
+// Position of p along the boundary of a convex polygon: i + t on the edge
+// from vertex i to vertex i + 1, for the closest point of the boundary
+double boundaryPosition(const std::vector<Point2>& polygon, const Point2& p) {
+    double best = 0.0;
+    double bestDistance = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        const Point2& a = polygon[i];
+        const Point2& b = polygon[(i + 1) % polygon.size()];
+        double length = (b - a).squared_length();
+        double t = length > 0.0 ? std::clamp(((p - a) * (b - a)) / length, 0.0, 1.0) : 0.0;
+        double distance = CGAL::squared_distance(p, a + t * (b - a));
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = static_cast<double>(i) + t;
+        }
+    }
+    return std::fmod(best, static_cast<double>(polygon.size()));
+}
+
+// Clips the contour edges to 'cell', bounded by 'faces' (outward unit
+// planes, also given as 'faceRows'). Vertices inside the cell are kept and
+// edges leaving it end at the boundary. The open chains left by the
+// clipping are closed along the section of the cell with the contour
+// plane, over the stretches of that section inside the contour.
+void clipContourToCell(const ContourPlane& contour, const SpacePartitioner::ConvexCell& cell,
+                       const std::vector<Plane>& faces, const PlanesSoA& faceRows,
+                       double tolerance, ClippedContour& clipped) {
+    clipped.vertices.clear();
+    clipped.edges.clear();
+    size_t n = contour.vertices.size();
+    if (n == 0) return;
+
+    // Contours without edges are taken as one closed polygon
+    std::vector<std::pair<int, int>> loop;
+    const std::vector<std::pair<int, int>>* edges = &contour.edges;
+    if (edges->empty() && n > 2) {
+        for (size_t i = 0; i < n; ++i) {
+            loop.emplace_back(static_cast<int>(i), static_cast<int>((i + 1) % n));
+        }
+        edges = &loop;
+    }
+
+    // Side of every contour vertex for every face, in one pass
+    PointsSoA points;
+    points.reserve(n);
+    for (const auto& p : contour.vertices) {
+        points.push_back(p.x(), p.y(), p.z());
+    }
+    SignMatrix signs;
+    signs.compute(faceRows, points, tolerance);
+
+    std::vector<bool> inside(n, true);
+    for (size_t f = 0; f < signs.planeCount(); ++f) {
+        const int8_t* row = signs.row(f);
+        for (size_t i = 0; i < n; ++i) {
+            if (row[i] > 0) inside[i] = false;
+        }
+    }
+
+    std::vector<int> kept(n, -1);
+    auto keepVertex = [&](size_t i) {
+        if (kept[i] < 0) {
+            kept[i] = static_cast<int>(clipped.vertices.size());
+            clipped.vertices.push_back(contour.vertices[i]);
+        }
+        return kept[i];
+    };
+    auto addPoint = [&](const Point& p) {
+        clipped.vertices.push_back(p);
+        return static_cast<int>(clipped.vertices.size() - 1);
+    };
+
+    for (const auto& edge : *edges) {
+        size_t a = static_cast<size_t>(edge.first);
+        size_t b = static_cast<size_t>(edge.second);
+        if (a >= n || b >= n || a == b) continue;
+
+        if (inside[a] && inside[b]) {
+            clipped.edges.emplace_back(keepVertex(a), keepVertex(b));
+            continue;
+        }
+
+        // Both ends beyond the same face
+        bool separated = false;
+        for (size_t f = 0; f < signs.planeCount() && !separated; ++f) {
+            separated = signs.at(f, a) > 0 && signs.at(f, b) > 0;
+        }
+        if (separated) continue;
+
+        const Point& pa = contour.vertices[a];
+        const Point& pb = contour.vertices[b];
+        double t0, t1;
+        if (!clipSegmentToConvex(faces, pa, pb, tolerance, t0, t1) ||
+            (t1 - t0) * std::sqrt(CGAL::squared_distance(pa, pb)) <= tolerance) {
+            continue;
+        }
+        int start = inside[a] ? keepVertex(a) : addPoint(pa + t0 * (pb - pa));
+        int end = inside[b] ? keepVertex(b) : addPoint(pa + t1 * (pb - pa));
+        clipped.edges.emplace_back(start, end);
+    }
+
+    // Chain ends lie on the boundary of the cell's section with the contour
+    // plane. The section boundary is cut at every chain end, and the
+    // stretches inside the contour are added, so that chains and stretches
+    // bound the part of the contour region inside the cell. Without chain
+    // ends the whole section is either inside the contour (around a hole)
+    // or outside of it.
+    PlaneFrame frame = PlaneFrame::fromPlane(contour.plane);
+    std::vector<Point2> section = convexSection(cell.vertices, contour.plane, frame, tolerance);
+    if (section.size() < 3) return;
+
+    std::vector<size_t> degree(clipped.vertices.size(), 0);
+    for (const auto& edge : clipped.edges) {
+        degree[edge.first]++;
+        degree[edge.second]++;
+    }
+    std::vector<std::pair<double, int>> ends;  // (boundary position, clipped vertex)
+    for (size_t i = 0; i < clipped.vertices.size(); ++i) {
+        if (degree[i] == 1) {
+            ends.emplace_back(boundaryPosition(section, frame.to2d(clipped.vertices[i])),
+                              static_cast<int>(i));
+        }
+    }
+    std::sort(ends.begin(), ends.end());
+
+    std::vector<Point2> contour2d;
+    contour2d.reserve(n);
+    for (const auto& p : contour.vertices) {
+        contour2d.push_back(frame.to2d(p));
+    }
+    double k = static_cast<double>(section.size());
+    auto pointAt = [&section, k](double position) {
+        position = std::fmod(position, k);
+        size_t i = static_cast<size_t>(position);
+        const Point2& a = section[i];
+        const Point2& b = section[(i + 1) % section.size()];
+        return a + (position - static_cast<double>(i)) * (b - a);
+    };
+
+    if (ends.empty()) {
+        if (insideContour(contour2d, *edges, pointAt(0.5))) {
+            int first = static_cast<int>(clipped.vertices.size());
+            for (size_t i = 0; i < section.size(); ++i) {
+                addPoint(frame.to3d(section[i]));
+                clipped.edges.emplace_back(first + static_cast<int>(i),
+                                           first + static_cast<int>((i + 1) % section.size()));
+            }
+        }
+        return;
+    }
+
+    // Stretch from position 'from' to 'to' (to > from, up to one turn)
+    // between the chain ends 'first' and 'last', over the section vertices
+    // in between
+    auto addStretch = [&](double from, double to, int first, int last) {
+        if (to - from <= 1e-12 * k) return;
+        if (!insideContour(contour2d, *edges, pointAt(0.5 * (from + to)))) return;
+
+        int previous = first;
+        for (double corner = std::floor(from) + 1.0; corner < to; corner += 1.0) {
+            int vertex = addPoint(frame.to3d(section[static_cast<size_t>(corner) % section.size()]));
+            clipped.edges.emplace_back(previous, vertex);
+            previous = vertex;
+        }
+        if (previous != last) {
+            clipped.edges.emplace_back(previous, last);
+        }
+    };
+
+    for (size_t i = 0; i < ends.size(); ++i) {
+        const auto& [from, first] = ends[i];
+        const auto& [next, last] = ends[(i + 1) % ends.size()];
+        double to = i + 1 < ends.size() ? next : next + k;
+        addStretch(from, to, first, last);
+    }
+}
+
+} // namespace
+
+Projection::Projection(const SpacePartitioner& partitioner,
+                       const CancellationToken* token,
+                       ProgressCallback progress,
+                       ReconstructionMethod method)
+    : m_method(method) {
     m_cells = partitioner.getConvexCells();
-    
+
+    // Cells refer to contours by their index in the store
+    m_contours = partitioner.getContourStore();
+    m_snapError = partitioner.getSnapError();
+    m_cellPlanes.reserve(m_cells.size());
+    for (const auto& cell : m_cells) {
+        m_cellPlanes.push_back(computeAxisAlignedPlanes(cell.bbox));
+    }
+
+    buildContourCells();
+
+    std::vector<size_t> cells(m_cells.size());
+    std::iota(cells.begin(), cells.end(), 0);
+    ProgressReporter reporter(token, std::move(progress));
+    computeProjections(cells, reporter);
+}
+
+size_t Projection::updateContours(const SpacePartitioner& partitioner,
+                                  const std::vector<size_t>& changedContours,
+                                  const CancellationToken* token,
+                                  ProgressCallback progress) {
+    const auto& cells = partitioner.getConvexCells();
+    if (cells.size() != m_cells.size()) {
+        throw std::runtime_error("updateContours: the partition changed, a new projection is needed");
+    }
+
+    // Cells that read a changed contour before the edit, and after it
+    std::vector<bool> affected(m_cells.size(), false);
+    for (size_t contourIdx : changedContours) {
+        if (contourIdx >= m_contourCells.size()) continue;
+        for (size_t cellIdx : m_contourCells[contourIdx]) {
+            affected[cellIdx] = true;
+        }
+    }
+
+    m_contours = partitioner.getContourStore();
+    m_snapError = partitioner.getSnapError();
     for (size_t i = 0; i < m_cells.size(); i++) {
-        auto planes = partitioner.getPlanesForCell(i);
-        for (const auto& plane : planes) {
-            auto it = std::find(m_contourPlanes.begin(), m_contourPlanes.end(), plane);
-            if (it == m_contourPlanes.end()) {
-                m_contourPlanes.push_back(plane);
-            }
+        m_cells[i].planeIndices = cells[i].planeIndices;
+    }
+    buildContourCells();
+    for (size_t contourIdx : changedContours) {
+        if (contourIdx >= m_contourCells.size()) continue;
+        for (size_t cellIdx : m_contourCells[contourIdx]) {
+            affected[cellIdx] = true;
         }
-        m_cellPlanes[i] = computeAxisAlignedPlanes(m_cells[i].geometry);
     }
 
-    computeProjections();
+    std::vector<size_t> dirty;
+    for (size_t cellIdx = 0; cellIdx < affected.size(); cellIdx++) {
+        if (affected[cellIdx]) dirty.push_back(cellIdx);
+    }
+    ProgressReporter reporter(token, std::move(progress));
+    computeProjections(dirty, reporter);
+    return dirty.size();
 }
 
-AxisPlanes Projection::computeAxisAlignedPlanes(const CGAL::Polyhedron_3<ExactKernel>& poly) const {
+void Projection::buildContourCells() {
+    m_contourCells.assign(m_contours->size(), {});
+    for (size_t cellIdx = 0; cellIdx < m_cells.size(); cellIdx++) {
+        for (size_t planeIdx : m_cells[cellIdx].planeIndices) {
+            if (planeIdx < m_contourCells.size()) {
+                m_contourCells[planeIdx].push_back(cellIdx);
+            }
+        }
+    }
+}
+
+AxisPlanes Projection::computeAxisAlignedPlanes(const CGAL::Bbox_3& bbox) const {
     AxisPlanes result;
     
-    auto bbox = CGAL::bounding_box(poly.points_begin(), poly.points_end());
-    double xmin = CGAL::to_double(bbox.xmin());
-    double ymin = CGAL::to_double(bbox.ymin());
-    double zmin = CGAL::to_double(bbox.zmin());
-    double xmax = CGAL::to_double(bbox.xmax());
-    double ymax = CGAL::to_double(bbox.ymax());
-    double zmax = CGAL::to_double(bbox.zmax());
+    double xmin = bbox.xmin();
+    double ymin = bbox.ymin();
+    double zmin = bbox.zmin();
+    double xmax = bbox.xmax();
+    double ymax = bbox.ymax();
+    double zmax = bbox.zmax();
 
     double xcenter = (xmin + xmax) / 2;
     double ycenter = (ymin + ymax) / 2;
@@ -90,36 +368,34 @@ void Projection::renderAxisPlanes(const AxisPlanes& planes) const {
 }
 
 void Projection::renderPlanesForAllCells() const {
-    for (size_t i = 0; i < m_cells.size(); i++) {
-        auto it = m_cellPlanes.find(i);
-        if (it != m_cellPlanes.end()) {
-            renderAxisPlanes(it->second);
-        }
+    for (const auto& planes : m_cellPlanes) {
+        renderAxisPlanes(planes);
     }
 }
 
-void Projection::renderPlanesForCell(const CGAL::Polyhedron_3<ExactKernel>& poly) const {
-    size_t cellIndex = 0;
-    for (size_t i = 0; i < m_cells.size(); i++) {
-        if (&m_cells[i].geometry == &poly) {
-            cellIndex = i;
-            break;
-        }
-    }
-    
-    auto it = m_cellPlanes.find(cellIndex);
-    if (it != m_cellPlanes.end()) {
-        renderAxisPlanes(it->second);
+void Projection::renderPlanesForCell(size_t cellIndex) const {
+    if (cellIndex < m_cellPlanes.size()) {
+        renderAxisPlanes(m_cellPlanes[cellIndex]);
     }
 }
 
 const AxisPlanes& Projection::getAxisPlanesForCell(size_t cellIndex) const {
-    auto it = m_cellPlanes.find(cellIndex);
-    if (it == m_cellPlanes.end()) {
+    if (cellIndex >= m_cellPlanes.size()) {
         static AxisPlanes empty;
         return empty;
     }
-    return it->second;
+    return m_cellPlanes[cellIndex];
+}
+
+const ContourPlane& Projection::getContour(const ProjectedContour& projection) const {
+    return (*m_contours)[projection.contourIndex];
+}
+
+const AxisPlanes::Plane* Projection::getProjectionPlane(size_t cellIndex,
+                                                        const ProjectedContour& projection) const {
+    const AxisPlanes& planes = getAxisPlanesForCell(cellIndex);
+    if (projection.projectionPlaneIndex >= planes.planes.size()) return nullptr;
+    return &planes.planes[projection.projectionPlaneIndex];
 }
 
 std::vector<ContourPlane> Projection::getPlanesForCell(size_t cellIndex) const {
@@ -127,8 +403,8 @@ std::vector<ContourPlane> Projection::getPlanesForCell(size_t cellIndex) const {
     
     std::vector<ContourPlane> planes;
     for (size_t planeIdx : m_cells[cellIndex].planeIndices) {
-        if (planeIdx < m_contourPlanes.size()) {
-            planes.push_back(m_contourPlanes[planeIdx]);
+        if (planeIdx < m_contours->size()) {
+            planes.push_back((*m_contours)[planeIdx]);
         }
     }
     return planes;
@@ -164,20 +440,20 @@ double Projection::computePlaneDotProduct(const Plane& contourPlane,
     return contourNormal * axisNormal;
 }
 
-const AxisPlanes::Plane* Projection::selectProjectionPlane(
+size_t Projection::selectProjectionPlane(
     const ContourPlane& contourPlane,
     const AxisPlanes& axisPlanes) const {
     
     double minDist = std::numeric_limits<double>::max();
-    const AxisPlanes::Plane* bestPlane = nullptr;
+    size_t bestPlane = ProjectedContour::npos;
     
-    for (const auto& plane : axisPlanes.planes) {
-        double dot = computePlaneDotProduct(contourPlane.plane, plane);
+    for (size_t i = 0; i < axisPlanes.planes.size(); i++) {
+        double dot = computePlaneDotProduct(contourPlane.plane, axisPlanes.planes[i]);
         // Find distance from +1 instead of -1
         double distFromOne = std::abs(dot - 1.0);
         if (distFromOne < minDist) {
             minDist = distFromOne;
-            bestPlane = &plane;
+            bestPlane = i;
         }
     }
     
@@ -218,101 +494,169 @@ std::vector<Point> Projection::projectVerticesOntoPlane(
 
 ReconstructedMesh Projection::triangulateVertices(const std::vector<Point>& points) const {
     ReconstructedMesh result;
-    result.vertices = points;
-    
-    // Create Delaunay triangulation
-    typedef CGAL::Triangulation_3<InexactKernel> Triangulation;
-    Triangulation T;
-    T.insert(points.begin(), points.end());
-
-    // Create vertex index mapping
-    std::map<Point, size_t> vertex_indices;
-    for(size_t i = 0; i < points.size(); i++) {
-        vertex_indices[points[i]] = i;
-    }
-
-    // Extract finite facets
-    for(auto fit = T.finite_facets_begin(); fit != T.finite_facets_end(); ++fit) {
-        std::array<size_t, 3> triangle;
-        
-        Triangulation::Cell_handle cell = fit->first;
-        int i = fit->second;
-        
-        for(int j = 0; j < 3; j++) {
-            Point p = cell->vertex(T.vertex_triple_index(i, j))->point();
-            triangle[j] = vertex_indices[p];
+    ReconstructionEngine::forThisThread().triangulate(points, result);
+    return result;
+}
+
+void Projection::computeProjections(const std::vector<size_t>& cells, ProgressReporter& progress) {
+    // Cells are independent: each one is reconstructed into its own slot
+    // and the slots are swapped in once all are done, so the result does
+    // not depend on scheduling and a cancelled run changes nothing
+    std::vector<CellProjections> slots(cells.size());
+
+    // Most expensive cells first, by the number of contour vertices they reconstruct
+    std::vector<size_t> cost(cells.size(), 0);
+    for (size_t job = 0; job < cells.size(); job++) {
+        for (size_t planeIdx : m_cells[cells[job]].planeIndices) {
+            if (planeIdx < m_contours->size()) {
+                cost[job] += (*m_contours)[planeIdx].vertices.size();
+            }
+        }
+    }
+    std::vector<size_t> order(cells.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&cost](size_t a, size_t b) { return cost[a] > cost[b]; });
+
+    std::atomic<size_t> nextJob{0};
+    std::atomic<size_t> finishedJobs{0};
+    std::atomic<bool> stop{false};
+    std::exception_ptr failure;
+    std::mutex failureMutex;
+
+    auto worker = [&]() {
+        try {
+            for (size_t job = nextJob++; job < order.size() && !stop; job = nextJob++) {
+                slots[order[job]] = projectCell(cells[order[job]]);
+                finishedJobs++;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(failureMutex);
+            if (!failure) failure = std::current_exception();
+            stop = true;
         }
-        
-        result.triangles.push_back(triangle);
+    };
+
+    size_t threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, order.size());
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threadCount; t++) {
+        workers.emplace_back(worker);
     }
 
-    // Create surface mesh
-    for (const auto& p : points) {
-        result.mesh.add_vertex(p);
+    // The calling thread only reports progress, which is also where a
+    // cancellation is noticed
+    try {
+        while (finishedJobs < order.size() && !stop) {
+            progress.report(double(finishedJobs) / std::max<size_t>(1, order.size()));
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    } catch (...) {
+        stop = true;
+        for (auto& thread : workers) thread.join();
+        throw;
     }
-    
-    for (const auto& triangle : result.triangles) {
-        result.mesh.add_face(
-            typename CGAL::Surface_mesh<Point>::Vertex_index(triangle[0]),
-            typename CGAL::Surface_mesh<Point>::Vertex_index(triangle[1]), 
-            typename CGAL::Surface_mesh<Point>::Vertex_index(triangle[2]));
+    for (auto& thread : workers) thread.join();
+    if (failure) {
+        std::rethrow_exception(failure);
     }
 
-    return result;
+    m_projectedContours.resize(m_cells.size());
+    size_t keptTriangles = 0, interiorFacets = 0;
+    for (size_t job = 0; job < cells.size(); job++) {
+        for (const auto& proj : slots[job].projections) {
+            keptTriangles += proj.reconstructedSurface.triangles.size();
+            interiorFacets += proj.reconstructedSurface.interiorFacets;
+        }
+        m_projectedContours[cells[job]] = std::move(slots[job]);
+    }
+    if (interiorFacets > 0) {
+        std::cout << "Reconstruction kept " << keptTriangles << " of "
+                  << keptTriangles + interiorFacets << " triangulation facets ("
+                  << interiorFacets << " interior facets dropped)" << std::endl;
+    }
+    progress.report(1.0);
 }
 
-void Projection::computeProjections() {
-    m_projectedContours.clear();
+CellProjections Projection::projectCell(size_t cellIdx) const {
+    CellProjections cellProj;
+    cellProj.cellIndex = cellIdx;
 
-    for (size_t cellIdx = 0; cellIdx < m_cells.size(); cellIdx++) {
-        CellProjections cellProj;
-        cellProj.cellIndex = cellIdx;
-
-        auto contourPlanes = getPlanesForCell(cellIdx);
-        const auto& axisPlanes = getAxisPlanesForCell(cellIdx);
-
-        // First check for extended mesh data
-        bool hasExtendedMesh = false;
-        for (const auto& contourPlane : contourPlanes) {
-            if (contourPlane.hasExt) {
-                ProjectedContour proj;
-                proj.originalPlane = &contourPlane;
-                proj.useExtendedMesh = true;
-                proj.reconstructedSurface = convertExtendedToReconstructedMesh(contourPlane.extMesh);
-                cellProj.projections.push_back(proj);
-                hasExtendedMesh = true;
-                break;
-            }
+    const auto& axisPlanes = getAxisPlanesForCell(cellIdx);
+
+    // Contours of the cell, as indices into the shared store
+    std::vector<size_t> contourIndices;
+    for (size_t planeIdx : m_cells[cellIdx].planeIndices) {
+        if (planeIdx < m_contours->size()) {
+            contourIndices.push_back(planeIdx);
         }
+    }
 
-        // Only proceed with normal reconstruction if no extended mesh was found
-        if (!hasExtendedMesh) {
-            for (const auto& contourPlane : contourPlanes) {
-                // Find best projection plane
-                const AxisPlanes::Plane* projPlane = selectProjectionPlane(contourPlane, axisPlanes);
-                if (!projPlane) continue;
-
-                ProjectedContour proj;
-                proj.originalPlane = &contourPlane;
-                proj.projectionPlane = projPlane;
-                
-                // Project vertices onto selected plane
-                proj.projectedVertices = projectVerticesOntoPlane(contourPlane.vertices, *projPlane);
-
-                // Reconstruct surface using original and projected vertices
-                proj.reconstructedSurface = reconstructCellSurface(
-                    contourPlane.vertices,
-                    proj.projectedVertices
-                );
-
-                cellProj.projections.push_back(proj);
-            }
+    // First check for extended mesh data
+    for (size_t contourIdx : contourIndices) {
+        const ContourPlane& contourPlane = (*m_contours)[contourIdx];
+        if (contourPlane.hasExt) {
+            ProjectedContour proj;
+            proj.contourIndex = contourIdx;
+            proj.useExtendedMesh = true;
+            proj.reconstructedSurface = convertExtendedToReconstructedMesh(contourPlane.extMesh);
+            cellProj.projections.push_back(std::move(proj));
+            return cellProj;
         }
+    }
 
-        if (!cellProj.projections.empty()) {
-            m_projectedContours.push_back(cellProj);
+    // Contours are clipped to the cell, so each cell only handles its own
+    // share of a contour
+    const auto& cell = m_cells[cellIdx];
+    std::vector<Plane> faces = SpacePartitioner::computeFacePlanes(cell);
+    PlanesSoA faceRows;
+    faceRows.reserve(faces.size());
+    for (const auto& face : faces) {
+        faceRows.push_back(face.a(), face.b(), face.c(), face.d());
+    }
+    double dx = cell.bbox.xmax() - cell.bbox.xmin();
+    double dy = cell.bbox.ymax() - cell.bbox.ymin();
+    double dz = cell.bbox.zmax() - cell.bbox.zmin();
+    // Contours are single precision input, and lie off snapped splitters
+    double tolerance = 1e-6 * std::sqrt(dx * dx + dy * dy + dz * dz) + m_snapError;
+    ClippedContour clipped;
+
+    // Only proceed with normal reconstruction if no extended mesh was found
+    for (size_t contourIdx : contourIndices) {
+        const ContourPlane* contourPlane = &(*m_contours)[contourIdx];
+
+        // Find best projection plane
+        size_t projPlaneIdx = selectProjectionPlane(*contourPlane, axisPlanes);
+        if (projPlaneIdx == ProjectedContour::npos) continue;
+        const AxisPlanes::Plane* projPlane = &axisPlanes.planes[projPlaneIdx];
+
+        ProjectedContour proj;
+        proj.contourIndex = contourIdx;
+        proj.projectionPlaneIndex = projPlaneIdx;
+
+        clipContourToCell(*contourPlane, cell, faces, faceRows, tolerance, clipped);
+        if (clipped.edges.empty()) continue;
+        proj.clippedVertices = clipped.vertices;
+
+        // Project vertices onto selected plane
+        proj.projectedVertices = projectVerticesOntoPlane(proj.clippedVertices, *projPlane);
+
+        // Reconstruct surface using clipped and projected vertices
+        if (m_method == ReconstructionMethod::PlanarCDT) {
+            ReconstructionEngine::forThisThread().triangulateContour(
+                contourPlane->plane, proj.clippedVertices, clipped.edges,
+                proj.projectedVertices, toPlane(*projPlane), proj.reconstructedSurface);
+        } else {
+            proj.reconstructedSurface = reconstructCellSurface(
+                proj.clippedVertices,
+                proj.projectedVertices,
+                clipped.edges
+            );
         }
+
+        cellProj.projections.push_back(std::move(proj));
     }
+    return cellProj;
 }
 
 ReconstructedMesh Projection::convertExtendedToReconstructedMesh(const ExtendedMesh& extMesh) const {
@@ -320,151 +664,31 @@ ReconstructedMesh Projection::convertExtendedToReconstructedMesh(const ExtendedM
     result.vertices = extMesh.vertices;
     
     // Convert faces to triangles format
+    result.triangles.reserve(extMesh.faces.size());
     for (const auto& face : extMesh.faces) {
         result.triangles.push_back({face.v1, face.v2, face.v3});
     }
 
-    // Create surface mesh
-    for (const auto& p : extMesh.vertices) {
-        result.mesh.add_vertex(p);
-    }
-    
-    for (const auto& triangle : result.triangles) {
-        result.mesh.add_face(
-            typename CGAL::Surface_mesh<Point>::Vertex_index(triangle[0]),
-            typename CGAL::Surface_mesh<Point>::Vertex_index(triangle[1]),
-            typename CGAL::Surface_mesh<Point>::Vertex_index(triangle[2])
-        );
-    }
-
     return result;
 }
 
 ReconstructedMesh Projection::reconstructCellSurface(
     const std::vector<Point>& originalVertices,
-    const std::vector<Point>& projectedVertices) const {
+    const std::vector<Point>& projectedVertices,
+    const std::vector<std::pair<int, int>>& edges) const {
 
+    // Single triangulation of the original and projected vertices combined
     ReconstructedMesh result;
-
-    // Combine original and projected vertices
-    std::vector<Point> combinedPoints;
-    combinedPoints.reserve(originalVertices.size() + projectedVertices.size());
-    combinedPoints.insert(combinedPoints.end(), originalVertices.begin(), originalVertices.end());
-    combinedPoints.insert(combinedPoints.end(), projectedVertices.begin(), projectedVertices.end());
-
-    // Perform triangulation on combined points
-    typedef CGAL::Triangulation_3<InexactKernel> Triangulation;
-    Triangulation T;
-    T.insert(combinedPoints.begin(), combinedPoints.end());
-
-    // Create vertex index mapping using std::map instead of unordered_map
-    std::map<Point, size_t> vertex_indices;
-    for (size_t i = 0; i < combinedPoints.size(); i++) {
-        vertex_indices[combinedPoints[i]] = i;
-    }
-
-    // Extract triangles from finite facets
-    result.triangles.clear();
-    for (auto fit = T.finite_facets_begin(); fit != T.finite_facets_end(); ++fit) {
-        std::array<size_t, 3> triangle;
-
-        Triangulation::Cell_handle cell = fit->first;
-        int i = fit->second;
-
-        for (int j = 0; j < 3; j++) {
-            Point p = cell->vertex(T.vertex_triple_index(i, j))->point();
-            triangle[j] = vertex_indices[p];
-        }
-
-        result.triangles.push_back(triangle);
-    }
-
-    // Store vertices
-    result.vertices = combinedPoints;
-
-    // Create surface mesh
-    CGAL::Surface_mesh<Point>& mesh = result.mesh;
-    mesh.clear();
-
-    // Add vertices
-    std::vector<typename CGAL::Surface_mesh<Point>::Vertex_index> mesh_vertex_indices;
-    for (const auto& p : combinedPoints) {
-        mesh_vertex_indices.push_back(mesh.add_vertex(p));
-    }
-
-    // Add faces
-    for (const auto& triangle : result.triangles) {
-        mesh.add_face(mesh_vertex_indices[triangle[0]],
-                      mesh_vertex_indices[triangle[1]],
-                      mesh_vertex_indices[triangle[2]]);
-    }
-
+    ReconstructionEngine::forThisThread().triangulate(originalVertices, projectedVertices, edges, result);
     return result;
 }
 
-
-void Projection::reconstructSurface(ProjectedContour& projection) {
-    // Combine original and projected vertices
-    std::vector<Point> combinedPoints;
-    combinedPoints.reserve(projection.originalPlane->vertices.size() + 
-                         projection.projectedVertices.size());
-    
-    // Add original vertices
-    combinedPoints.insert(combinedPoints.end(),
-                         projection.originalPlane->vertices.begin(),
-                         projection.originalPlane->vertices.end());
-    
-    // Add projected vertices
-    combinedPoints.insert(combinedPoints.end(),
-                         projection.projectedVertices.begin(),
-                         projection.projectedVertices.end());
-
-    // Store combined vertices
-    projection.reconstructedSurface.vertices = combinedPoints;
-
-    // Perform single triangulation on combined points
-    typedef CGAL::Triangulation_3<InexactKernel> Triangulation;
-    Triangulation T;
-    T.insert(combinedPoints.begin(), combinedPoints.end());
-
-    // Create vertex index mapping
-    std::map<Point, size_t> vertex_indices;
-    for(size_t i = 0; i < combinedPoints.size(); i++) {
-        vertex_indices[combinedPoints[i]] = i;
-    }
-
-    // Extract triangles from finite facets
-    projection.reconstructedSurface.triangles.clear();
-    for(auto fit = T.finite_facets_begin(); fit != T.finite_facets_end(); ++fit) {
-        std::array<size_t, 3> triangle;
-        
-        Triangulation::Cell_handle cell = fit->first;
-        int i = fit->second;
-        
-        for(int j = 0; j < 3; j++) {
-            Point p = cell->vertex(T.vertex_triple_index(i, j))->point();
-            triangle[j] = vertex_indices[p];
-        }
-        
-        projection.reconstructedSurface.triangles.push_back(triangle);
-    }
-
-    // Create surface mesh
-    CGAL::Surface_mesh<Point>& mesh = projection.reconstructedSurface.mesh;
-    mesh.clear();
-    
-    // Add vertices
-    std::vector<typename CGAL::Surface_mesh<Point>::Vertex_index> mesh_vertex_indices;
-    for (const auto& p : combinedPoints) {
-        mesh_vertex_indices.push_back(mesh.add_vertex(p));
-    }
-    
-    // Add faces
-    for (const auto& triangle : projection.reconstructedSurface.triangles) {
-        mesh.add_face(mesh_vertex_indices[triangle[0]], 
-                     mesh_vertex_indices[triangle[1]], 
-                     mesh_vertex_indices[triangle[2]]);
-    }
+void Projection::reconstructSurface(ProjectedContour& projection,
+                                    const std::vector<std::pair<int, int>>& edges) {
+    ReconstructionEngine::forThisThread().triangulate(projection.clippedVertices,
+                                                      projection.projectedVertices,
+                                                      edges,
+                                                      projection.reconstructedSurface);
 }
 
 void Projection::renderReconstructedSurface(const ReconstructedMesh& mesh) const {
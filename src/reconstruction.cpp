@@ -0,0 +1,280 @@
+// reconstruction.cpp
+#include "reconstruction.h"
+#include <algorithm>
+
+void ReconstructionEngine::triangulate(const std::vector<Point>& points, ReconstructedMesh& result) {
+    result.vertices.assign(points.begin(), points.end());
+    triangulateVertices(0, result);
+}
+
+void ReconstructionEngine::triangulate(const std::vector<Point>& first,
+                                       const std::vector<Point>& second,
+                                       const std::vector<std::pair<int, int>>& edges,
+                                       ReconstructedMesh& result) {
+    result.vertices.clear();
+    result.vertices.reserve(first.size() + second.size());
+    result.vertices.insert(result.vertices.end(), first.begin(), first.end());
+    result.vertices.insert(result.vertices.end(), second.begin(), second.end());
+
+    // Edges as sorted index pairs, looked up by isSurfaceFacet
+    size_t n = first.size();
+    m_edgeKeys.clear();
+    if (edges.empty() && n > 2) {
+        for (size_t i = 0; i < n; ++i) {
+            m_edgeKeys.emplace_back(std::min(i, (i + 1) % n), std::max(i, (i + 1) % n));
+        }
+    }
+    for (const auto& edge : edges) {
+        size_t a = static_cast<size_t>(edge.first);
+        size_t b = static_cast<size_t>(edge.second);
+        if (a >= n || b >= n || a == b) continue;
+        m_edgeKeys.emplace_back(std::min(a, b), std::max(a, b));
+    }
+    std::sort(m_edgeKeys.begin(), m_edgeKeys.end());
+
+    triangulateVertices(n == second.size() ? n : 0, result);
+}
+
+void ReconstructionEngine::triangulateVertices(size_t contourSize, ReconstructedMesh& result) {
+    IndexedTriangulation& T = m_triangulation;
+    T.clear();
+
+    // Points are inserted one by one so each vertex can take its index. A
+    // point equal to an earlier one creates no vertex and is represented
+    // by the earlier index.
+    result.mergedDuplicates = 0;
+    IndexedTriangulation::Cell_handle hint;
+    for (size_t i = 0; i < result.vertices.size(); ++i) {
+        size_t before = T.number_of_vertices();
+        IndexedTriangulation::Vertex_handle v = T.insert(result.vertices[i], hint);
+        if (T.number_of_vertices() > before) {
+            v->info() = i;
+        } else {
+            result.mergedDuplicates++;
+        }
+        hint = v->cell();
+    }
+
+    // Written straight into the result, reserved for every finite facet
+    result.triangles.clear();
+    result.triangles.reserve(T.number_of_finite_facets());
+    result.interiorFacets = 0;
+    for (auto fit = T.finite_facets_begin(); fit != T.finite_facets_end(); ++fit) {
+        IndexedTriangulation::Cell_handle cell = fit->first;
+        int i = fit->second;
+
+        std::array<size_t, 3> triangle;
+        for (int j = 0; j < 3; j++) {
+            triangle[j] = cell->vertex(T.vertex_triple_index(i, j))->info();
+        }
+        if (isSurfaceFacet(*fit, triangle, contourSize)) {
+            result.triangles.push_back(triangle);
+        } else {
+            result.interiorFacets++;
+        }
+    }
+    result.invalidateSurfaceMesh();
+}
+
+bool ReconstructionEngine::isSurfaceFacet(const IndexedTriangulation::Facet& facet,
+                                          const std::array<size_t, 3>& triangle,
+                                          size_t contourSize) const {
+    const IndexedTriangulation& T = m_triangulation;
+
+    // Flat input has only finite facets, all of them on the surface
+    if (T.dimension() < 3) return true;
+
+    // On the convex hull
+    if (T.is_infinite(facet.first) || T.is_infinite(T.mirror_facet(facet).first)) {
+        return true;
+    }
+    if (contourSize == 0) return false;
+
+    // Joins the contour and its projection through a vertex and its own
+    // image, next to a neighbour of that vertex along a contour edge, on
+    // either side
+    for (int j = 0; j < 3; j++) {
+        size_t a = std::min(triangle[j], triangle[(j + 1) % 3]);
+        size_t b = std::max(triangle[j], triangle[(j + 1) % 3]);
+        size_t c = triangle[(j + 2) % 3];
+        if (a >= contourSize || b != a + contourSize) continue;
+
+        size_t other = c % contourSize;
+        std::pair<size_t, size_t> key(std::min(a, other), std::max(a, other));
+        if (other != a && std::binary_search(m_edgeKeys.begin(), m_edgeKeys.end(), key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ReconstructionEngine::triangulateContour(const ContourPlane& contour,
+                                              const std::vector<Point>& projected,
+                                              const Plane& projectionPlane,
+                                              ReconstructedMesh& result) {
+    triangulateContour(contour.plane, contour.vertices, contour.edges, projected, projectionPlane, result);
+}
+
+void ReconstructionEngine::triangulateContour(const Plane& plane, const std::vector<Point>& vertices,
+                                              const std::vector<std::pair<int, int>>& edges,
+                                              const std::vector<Point>& projected,
+                                              const Plane& projectionPlane,
+                                              ReconstructedMesh& result) {
+    size_t n = vertices.size();
+    result.vertices.clear();
+    result.vertices.reserve(2 * n);
+    result.vertices.insert(result.vertices.end(), vertices.begin(), vertices.end());
+    result.vertices.insert(result.vertices.end(), projected.begin(), projected.end());
+    result.mergedDuplicates = 0;
+    result.interiorFacets = 0;
+
+    // Contours without edges are taken as one closed polygon
+    m_edges.assign(edges.begin(), edges.end());
+    if (m_edges.empty() && n > 2) {
+        for (size_t i = 0; i < n; ++i) {
+            m_edges.emplace_back(static_cast<int>(i), static_cast<int>((i + 1) % n));
+        }
+    }
+
+    // A cap of n points has fewer than 2n triangles, the band two per edge
+    result.triangles.clear();
+    result.triangles.reserve(4 * n + 2 * m_edges.size());
+
+    // Counter-clockwise faces in a frame point along the frame normal. Both
+    // caps are turned to face away from each other: the contour cap away
+    // from the projection plane, the projection cap towards it.
+    PlaneFrame contourFrame = PlaneFrame::fromPlane(plane);
+    PlaneFrame projectionFrame = PlaneFrame::fromPlane(projectionPlane);
+    Vector towardsContour = projectionPlane.orthogonal_vector();
+    if (n > 0 && projectionPlane.oriented_side(vertices.front()) == CGAL::ON_NEGATIVE_SIDE) {
+        towardsContour = -towardsContour;
+    }
+    triangulateCap(vertices, 0, contourFrame, contourFrame.normal * towardsContour < 0, result);
+    triangulateCap(projected, n, projectionFrame, projectionFrame.normal * towardsContour > 0, result);
+
+    // Band between each contour edge and its projection
+    for (const auto& edge : m_edges) {
+        size_t a = static_cast<size_t>(edge.first);
+        size_t b = static_cast<size_t>(edge.second);
+        if (a >= n || b >= n || a == b) continue;
+        result.triangles.push_back({a, b, n + b});
+        result.triangles.push_back({a, n + b, n + a});
+    }
+
+    result.invalidateSurfaceMesh();
+}
+
+void ReconstructionEngine::triangulateCap(const std::vector<Point>& vertices, size_t offset,
+                                          const PlaneFrame& frame, bool flip,
+                                          ReconstructedMesh& result) {
+    PlanarCDT& cdt = m_cdt;
+    cdt.clear();
+
+    // A point equal to an earlier one keeps the earlier index
+    m_cdtVertices.clear();
+    PlanarCDT::Face_handle hint;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        PlanarCDT::Vertex_handle v = cdt.insert(frame.to2d(vertices[i]), hint);
+        if (v->info().index == PlanarVertexInfo::npos) {
+            v->info().index = offset + i;
+        } else {
+            result.mergedDuplicates++;
+        }
+        m_cdtVertices.push_back(v);
+        hint = v->face();
+    }
+
+    for (const auto& edge : m_edges) {
+        size_t a = static_cast<size_t>(edge.first);
+        size_t b = static_cast<size_t>(edge.second);
+        if (a >= m_cdtVertices.size() || b >= m_cdtVertices.size()) continue;
+        if (m_cdtVertices[a] != m_cdtVertices[b]) {
+            cdt.insert_constraint(m_cdtVertices[a], m_cdtVertices[b]);
+        }
+    }
+    if (cdt.dimension() < 2) return;
+
+    // Crossing constraints create new points; lift them back to 3D
+    for (auto v : cdt.finite_vertex_handles()) {
+        if (v->info().index == PlanarVertexInfo::npos) {
+            v->info().index = result.vertices.size();
+            result.vertices.push_back(frame.to3d(v->point()));
+        }
+    }
+
+    markDomains();
+    for (auto f : cdt.finite_face_handles()) {
+        if (!f->info().inDomain()) continue;
+        size_t i0 = f->vertex(0)->info().index;
+        size_t i1 = f->vertex(1)->info().index;
+        size_t i2 = f->vertex(2)->info().index;
+        if (flip) {
+            result.triangles.push_back({i0, i2, i1});
+        } else {
+            result.triangles.push_back({i0, i1, i2});
+        }
+    }
+}
+
+void ReconstructionEngine::markDomains() {
+    // Nesting level of each face: 0 outside, and one more for every
+    // constraint crossed on the way in from the infinite face
+    PlanarCDT& cdt = m_cdt;
+    for (auto f : cdt.all_face_handles()) {
+        f->info().nestingLevel = -1;
+    }
+
+    std::list<PlanarCDT::Edge> border;
+    auto flood = [&cdt, &border](PlanarCDT::Face_handle start, int level) {
+        if (start->info().nestingLevel != -1) return;
+        std::list<PlanarCDT::Face_handle> queue;
+        queue.push_back(start);
+        while (!queue.empty()) {
+            PlanarCDT::Face_handle f = queue.front();
+            queue.pop_front();
+            if (f->info().nestingLevel != -1) continue;
+            f->info().nestingLevel = level;
+            for (int i = 0; i < 3; ++i) {
+                PlanarCDT::Face_handle neighbor = f->neighbor(i);
+                if (neighbor->info().nestingLevel != -1) continue;
+                if (cdt.is_constrained(PlanarCDT::Edge(f, i))) {
+                    border.push_back(PlanarCDT::Edge(f, i));
+                } else {
+                    queue.push_back(neighbor);
+                }
+            }
+        }
+    };
+
+    flood(cdt.infinite_face(), 0);
+    while (!border.empty()) {
+        PlanarCDT::Edge edge = border.front();
+        border.pop_front();
+        PlanarCDT::Face_handle neighbor = edge.first->neighbor(edge.second);
+        if (neighbor->info().nestingLevel == -1) {
+            flood(neighbor, edge.first->info().nestingLevel + 1);
+        }
+    }
+}
+
+const CGAL::Surface_mesh<Point>& ReconstructedMesh::surfaceMesh() const {
+    if (cachedSurfaceMesh) return *cachedSurfaceMesh;
+
+    auto mesh = std::make_shared<CGAL::Surface_mesh<Point>>();
+    mesh->reserve(vertices.size(), 3 * triangles.size(), triangles.size());
+    for (const auto& p : vertices) {
+        mesh->add_vertex(p);
+    }
+    for (const auto& triangle : triangles) {
+        mesh->add_face(CGAL::Surface_mesh<Point>::Vertex_index(triangle[0]),
+                       CGAL::Surface_mesh<Point>::Vertex_index(triangle[1]),
+                       CGAL::Surface_mesh<Point>::Vertex_index(triangle[2]));
+    }
+    cachedSurfaceMesh = mesh;
+    return *cachedSurfaceMesh;
+}
+
+ReconstructionEngine& ReconstructionEngine::forThisThread() {
+    thread_local ReconstructionEngine engine;
+    return engine;
+}
@@ -0,0 +1,163 @@
+// sign_matrix.cpp
+#include "sign_matrix.h"
+#include <cmath>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SIGN_MATRIX_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Bound on the relative rounding error of a*x + b*y + c*z + d evaluated
+// left to right in double: gamma_4 = 4u / (1 - 4u), rounded up
+const double kErrorBound = 5.0 * 0x1p-53;
+
+void scalarRow(double a, double b, double c, double d,
+               const double* x, const double* y, const double* z, size_t n,
+               double tolerance, int8_t* out) {
+    double absA = std::abs(a), absB = std::abs(b), absC = std::abs(c), absD = std::abs(d);
+
+    for (size_t i = 0; i < n; ++i) {
+        double value = a * x[i] + b * y[i] + c * z[i] + d;
+        double magnitude = absA * std::abs(x[i]) + absB * std::abs(y[i]) + absC * std::abs(z[i]) + absD;
+        double bound = tolerance + kErrorBound * magnitude;
+        out[i] = value > bound ? 1 : (value < -bound ? -1 : 0);
+    }
+}
+
+#ifdef SIGN_MATRIX_HAS_AVX2
+// Same evaluation order as scalarRow and no FMA, so both kernels give the
+// same matrix
+__attribute__((target("avx2")))
+void avx2Row(double a, double b, double c, double d, const PointsSoA& points,
+             double tolerance, int8_t* out) {
+    const double* x = points.x.data();
+    const double* y = points.y.data();
+    const double* z = points.z.data();
+    size_t n = points.size();
+
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    const __m256d va = _mm256_set1_pd(a), vb = _mm256_set1_pd(b);
+    const __m256d vc = _mm256_set1_pd(c), vd = _mm256_set1_pd(d);
+    const __m256d absA = _mm256_andnot_pd(signMask, va), absB = _mm256_andnot_pd(signMask, vb);
+    const __m256d absC = _mm256_andnot_pd(signMask, vc), absD = _mm256_andnot_pd(signMask, vd);
+    const __m256d vtol = _mm256_set1_pd(tolerance);
+    const __m256d verr = _mm256_set1_pd(kErrorBound);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d px = _mm256_loadu_pd(x + i);
+        __m256d py = _mm256_loadu_pd(y + i);
+        __m256d pz = _mm256_loadu_pd(z + i);
+
+        __m256d value = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(va, px),
+                                                                  _mm256_mul_pd(vb, py)),
+                                                    _mm256_mul_pd(vc, pz)),
+                                      vd);
+        __m256d magnitude = _mm256_add_pd(
+            _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(absA, _mm256_andnot_pd(signMask, px)),
+                                        _mm256_mul_pd(absB, _mm256_andnot_pd(signMask, py))),
+                          _mm256_mul_pd(absC, _mm256_andnot_pd(signMask, pz))),
+            absD);
+        __m256d bound = _mm256_add_pd(vtol, _mm256_mul_pd(verr, magnitude));
+
+        int positive = _mm256_movemask_pd(_mm256_cmp_pd(value, bound, _CMP_GT_OQ));
+        int negative = _mm256_movemask_pd(_mm256_cmp_pd(value, _mm256_xor_pd(bound, signMask), _CMP_LT_OQ));
+        for (int k = 0; k < 4; ++k) {
+            out[i + k] = static_cast<int8_t>(((positive >> k) & 1) - ((negative >> k) & 1));
+        }
+    }
+
+    // Remainder through the scalar path
+    scalarRow(a, b, c, d, x + i, y + i, z + i, n - i, tolerance, out + i);
+}
+#endif
+
+} // namespace
+
+void PointsSoA::reserve(size_t n) {
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+}
+
+void PointsSoA::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+}
+
+void PointsSoA::push_back(double px, double py, double pz) {
+    x.push_back(px);
+    y.push_back(py);
+    z.push_back(pz);
+}
+
+void PlanesSoA::reserve(size_t n) {
+    a.reserve(n);
+    b.reserve(n);
+    c.reserve(n);
+    d.reserve(n);
+}
+
+void PlanesSoA::clear() {
+    a.clear();
+    b.clear();
+    c.clear();
+    d.clear();
+}
+
+void PlanesSoA::push_back(double pa, double pb, double pc, double pd) {
+    a.push_back(pa);
+    b.push_back(pb);
+    c.push_back(pc);
+    d.push_back(pd);
+}
+
+bool hasAvx2SignKernel() {
+#ifdef SIGN_MATRIX_HAS_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void SignMatrix::compute(const PlanesSoA& planes, const PointsSoA& points, double tolerance,
+                         SignKernel kernel) {
+    if (kernel == SignKernel::Avx2 && !hasAvx2SignKernel()) {
+        throw std::runtime_error("AVX2 sign kernel is not available on this machine");
+    }
+    bool useAvx2 = kernel == SignKernel::Avx2 || (kernel == SignKernel::Auto && hasAvx2SignKernel());
+
+    m_planes = planes.size();
+    m_points = points.size();
+    m_signs.resize(m_planes * m_points);
+
+    for (size_t p = 0; p < m_planes; ++p) {
+        int8_t* out = m_signs.data() + p * m_points;
+#ifdef SIGN_MATRIX_HAS_AVX2
+        if (useAvx2) {
+            avx2Row(planes.a[p], planes.b[p], planes.c[p], planes.d[p], points, tolerance, out);
+            continue;
+        }
+#else
+        (void)useAvx2;
+#endif
+        scalarRow(planes.a[p], planes.b[p], planes.c[p], planes.d[p],
+                  points.x.data(), points.y.data(), points.z.data(), m_points, tolerance, out);
+    }
+}
+
+SignMatrix::Counts SignMatrix::count(size_t plane, size_t begin, size_t end) const {
+    Counts counts;
+    const int8_t* signs = row(plane);
+    for (size_t i = begin; i < end; ++i) {
+        counts.positive += signs[i] > 0;
+        counts.negative += signs[i] < 0;
+        counts.onPlane += signs[i] == 0;
+    }
+    return counts;
+}